@@ -0,0 +1,459 @@
+#include "codec.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+// Defined option for the command line arguements
+#define OPTIONS "m:k:f:s:w:r:lec"
+
+// Smallest input and the factor between two input sizes
+#define MIN_SIZE 1024
+#define SIZE_STEP 16
+
+// Seconds each input is compressed and decompressed for at least
+#define MIN_TIME 0.2
+
+// Largest input size in MiB, kinds of generated input and files to load
+uint64_t max_mib = 64;
+char default_kinds[] = "text,binary,zero,random,logs";
+char *kinds = default_kinds;
+char *files[64];
+int nfiles = 0;
+uint64_t seed = 0x9e3779b97f4a7c15;
+
+// Code width, reset policy and threshold of the codecs, and whether they
+// use LZW, entropy coding and a checksum
+uint8_t width = DEFAULT_WIDTH;
+uint8_t policy = RESET_FULL;
+uint8_t threshold = DEFAULT_THRESHOLD;
+bool lzw = false;
+bool entropy = false;
+bool checksum = false;
+
+//
+// Returns the next number of a xorshift64* generator.
+// The corpus only depends on the seed, so every run sees the same inputs.
+//
+// state:   State of the generator.
+// returns: Next pseudo-random number.
+//
+static uint64_t rng(uint64_t *state) {
+  *state ^= *state >> 12;
+  *state ^= *state << 25;
+  *state ^= *state >> 27;
+  return *state * 0x2545f4914f6cdd1d;
+}
+
+//
+// Fills a buffer with English-like text, words drawn with a skew towards
+// the start of the word list the way word frequencies are skewed.
+//
+// buf:     Buffer to fill.
+// len:     Number of bytes to fill.
+// returns: Void.
+//
+static void gen_text(uint8_t *buf, uint64_t len) {
+  static const char *words[] = { "the", "of", "and", "to", "in", "a", "is",
+    "that", "for", "it", "as", "was", "with", "be", "by", "on", "not", "he",
+    "this", "are", "or", "his", "from", "at", "which", "but", "have", "an",
+    "had", "they", "you", "were", "their", "one", "all", "we", "can", "her",
+    "has", "there", "been", "if", "more", "when", "will", "would", "who",
+    "so", "no", "compression", "dictionary", "phrase", "symbol", "stream",
+    "buffer", "encoder", "decoder", "history", "table", "window", "literal",
+    "match", "length", "distance" };
+  uint64_t state = seed;
+  uint64_t i = 0;
+  uint32_t n = 0;
+  while (i < len) {
+    uint64_t r = rng(&state);
+    const char *w = words[r % (r % 64 + 1)];
+    for (uint64_t j = 0; w[j] && i < len; j++) {
+      buf[i++] = w[j];
+    }
+    if (i < len) {
+      n++;
+      buf[i++] = n % 12 == 0 ? '\n' : (r >> 32) % 16 == 0 ? ',' : ' ';
+    }
+  }
+  return;
+}
+
+//
+// Fills a buffer with binary records, a counter, a few small fields and a
+// value with noisy low bits, like a table of samples.
+//
+// buf:     Buffer to fill.
+// len:     Number of bytes to fill.
+// returns: Void.
+//
+static void gen_binary(uint8_t *buf, uint64_t len) {
+  uint64_t state = seed;
+  uint8_t rec[32];
+  uint64_t i = 0;
+  for (uint32_t id = 0; i < len; id++) {
+    uint64_t r = rng(&state);
+    uint32_t type = r % 8;
+    uint32_t flags = (r >> 8) % 4;
+    uint64_t value = 1000000 + (id << 6) + (r >> 58);
+    memset(rec, 0, sizeof(rec));
+    memcpy(rec, &id, sizeof(id));
+    memcpy(rec + 4, &type, sizeof(type));
+    memcpy(rec + 8, &flags, sizeof(flags));
+    memcpy(rec + 16, &value, sizeof(value));
+    uint64_t n = len - i < sizeof(rec) ? len - i : sizeof(rec);
+    memcpy(buf + i, rec, n);
+    i += n;
+  }
+  return;
+}
+
+//
+// Fills a buffer with pseudo-random bytes, which don't compress.
+//
+// buf:     Buffer to fill.
+// len:     Number of bytes to fill.
+// returns: Void.
+//
+static void gen_random(uint8_t *buf, uint64_t len) {
+  uint64_t state = seed;
+  for (uint64_t i = 0; i < len; i += 8) {
+    uint64_t r = rng(&state);
+    memcpy(buf + i, &r, len - i < 8 ? len - i : 8);
+  }
+  return;
+}
+
+//
+// Fills a buffer with log lines that differ only in their timestamp, a few
+// fields and one of a handful of messages.
+//
+// buf:     Buffer to fill.
+// len:     Number of bytes to fill.
+// returns: Void.
+//
+static void gen_logs(uint8_t *buf, uint64_t len) {
+  static const char *levels[] = { "INFO ", "INFO ", "INFO ", "DEBUG", "WARN " };
+  static const char *msgs[] = { "request served", "cache hit",
+    "cache miss, fetching from origin", "connection reset by peer",
+    "slow request" };
+  uint64_t state = seed;
+  char line[160];
+  uint64_t i = 0;
+  for (uint64_t ms = 0; i < len; ms += 7) {
+    uint64_t r = rng(&state);
+    int n = snprintf(line, sizeof(line),
+        "2024-03-01T%02lu:%02lu:%02lu.%03luZ %s [worker-%lu] %s id=%08lx "
+        "status=%d latency=%lums\n",
+        ms / 3600000 % 24, ms / 60000 % 60, ms / 1000 % 60, ms % 1000,
+        levels[r % 5], (r >> 8) % 8, msgs[(r >> 16) % 5], r >> 32,
+        (r >> 24) % 16 ? 200 : 503, (r >> 40) % 250);
+    uint64_t m = len - i < (uint64_t)n ? len - i : (uint64_t)n;
+    memcpy(buf + i, line, m);
+    i += m;
+  }
+  return;
+}
+
+//
+// Generates an input of one kind.
+//
+// kind:    Name of the kind of input.
+// len:     Number of bytes to generate.
+// returns: Buffer of generated bytes, NULL if the kind is unknown.
+//
+static uint8_t *generate(const char *kind, uint64_t len) {
+  uint8_t *buf = (uint8_t *)malloc(len);
+  if (!buf) {
+    printf("Error: Failed to allocate memory for input!\n");
+    exit(EXIT_FAILURE);
+  }
+  if (strcmp(kind, "text") == 0) {
+    gen_text(buf, len);
+  } else if (strcmp(kind, "binary") == 0) {
+    gen_binary(buf, len);
+  } else if (strcmp(kind, "zero") == 0) {
+    memset(buf, 0, len);
+  } else if (strcmp(kind, "random") == 0) {
+    gen_random(buf, len);
+  } else if (strcmp(kind, "logs") == 0) {
+    gen_logs(buf, len);
+  } else {
+    free(buf);
+    return NULL;
+  }
+  return buf;
+}
+
+//
+// Loads a whole file into memory.
+//
+// path:    Path of the file.
+// len:     Pointer to store the number of bytes in the file into.
+// returns: Buffer of the bytes in the file.
+//
+static uint8_t *load(const char *path, uint64_t *len) {
+  int fd = open(path, O_RDONLY);
+  struct stat st;
+  if (fd < 0 || fstat(fd, &st) < 0) {
+    printf("Error: Failed to open %s!\n", path);
+    exit(EXIT_FAILURE);
+  }
+  uint8_t *buf = (uint8_t *)malloc(st.st_size + 1);
+  if (!buf) {
+    printf("Error: Failed to allocate memory for input!\n");
+    exit(EXIT_FAILURE);
+  }
+  *len = 0;
+  ssize_t n = 0;
+  while ((n = read(fd, buf + *len, st.st_size - *len)) > 0) {
+    *len += n;
+  }
+  close(fd);
+  return buf;
+}
+
+//
+// Returns the time of a monotonic clock in seconds.
+//
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+//
+// Compresses or decompresses an input in memory over and over until
+// MIN_TIME has passed, reusing the Codec for each pass.
+//
+// c:       Codec to run.
+// in:      Input bytes.
+// len:     Number of input bytes.
+// encode:  True to compress, false to decompress.
+// returns: Seconds a single pass takes.
+//
+static double run(Codec *c, const uint8_t *in, uint64_t len, bool encode) {
+  uint64_t passes = 0;
+  double start = now();
+  double elapsed = 0;
+  do {
+    codec_reset(c);
+    c->in_mem = in;
+    c->in_len = len;
+    if (encode) {
+      codec_encode(c);
+    } else {
+      codec_decode(c);
+    }
+    passes++;
+    elapsed = now() - start;
+  } while (elapsed < MIN_TIME);
+  return elapsed / passes;
+}
+
+//
+// Benchmarks a single input and prints its row of the report.
+// This runs in a child process so the peak RSS is that of this input alone.
+//
+// name:    Name of the input to print.
+// in:      Input bytes.
+// len:     Number of input bytes.
+// returns: Void.
+//
+static void bench(const char *name, const uint8_t *in, uint64_t len) {
+  Codec *enc = encoder_create(MEM_FD, MEM_FD);
+  codec_set_width(enc, width);
+  codec_set_policy(enc, policy, threshold);
+  codec_set_lzw(enc, lzw);
+  codec_set_entropy(enc, entropy);
+  codec_set_checksum(enc, checksum);
+  double enc_time = run(enc, in, len, true);
+
+  Codec *dec = decoder_create(MEM_FD, MEM_FD);
+  codec_set_width(dec, width);
+  codec_set_policy(dec, policy, threshold);
+  codec_set_lzw(dec, lzw);
+  codec_set_entropy(dec, entropy);
+  codec_set_checksum(dec, checksum);
+  double dec_time = run(dec, enc->out_mem, enc->out_len, false);
+  if (dec->out_len != len || memcmp(dec->out_mem, in, len) != 0) {
+    printf("Error: %s did not decompress to its input!\n", name);
+    exit(EXIT_FAILURE);
+  }
+
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  double mb = len / 1e6;
+  printf("%-12s %12lu %12lu %8.3f %10.1f %10.1f %8lu %10.1f\n", name, len,
+      enc->out_len, len ? (double)enc->out_len / len : 0, mb / enc_time,
+      mb / dec_time, enc->resets, usage.ru_maxrss / 1024.0);
+  fflush(stdout);
+
+  codec_delete(enc);
+  codec_delete(dec);
+  return;
+}
+
+//
+// Runs a benchmark of a generated or loaded input in a child process.
+//
+// kind:    Kind of input to generate, NULL to load a file.
+// path:    Path of the file to load.
+// len:     Number of bytes to generate.
+// returns: Void.
+//
+static void bench_child(const char *kind, const char *path, uint64_t len) {
+  // Flush the report first, or the child prints it again when it exits
+  fflush(stdout);
+  pid_t pid = fork();
+  if (pid < 0) {
+    printf("Error: Failed to fork!\n");
+    exit(EXIT_FAILURE);
+  }
+  if (pid == 0) {
+    uint8_t *in = NULL;
+    const char *name = kind;
+    if (kind) {
+      in = generate(kind, len);
+      if (!in) {
+        printf("Error: Unknown kind of input %s!\n", kind);
+        exit(EXIT_FAILURE);
+      }
+    } else {
+      in = load(path, &len);
+      name = strrchr(path, '/') ? strrchr(path, '/') + 1 : path;
+    }
+    bench(name, in, len);
+    free(in);
+    exit(EXIT_SUCCESS);
+  }
+
+  int status = 0;
+  waitpid(pid, &status, 0);
+  if (!WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS) {
+    exit(EXIT_FAILURE);
+  }
+  return;
+}
+
+//
+// This function parses through the command line arguments
+// and sets the appropriate flags for the program
+//
+// int argc:		The number of command line arguements to parse through
+// char **argv:		Char pointer holding all the arguments
+//
+void get_options(int argc, char **argv);
+
+int main(int argc, char **argv) {
+  get_options(argc, argv);
+
+  printf("%-12s %12s %12s %8s %10s %10s %8s %10s\n", "input", "bytes",
+      "compressed", "ratio", "enc MB/s", "dec MB/s", "resets", "RSS MiB");
+
+  // Generate each kind of input at every size up to and including the max
+  char *kind = strtok(kinds, ",");
+  while (kind) {
+    uint64_t max = max_mib << 20;
+    uint64_t len = MIN_SIZE;
+    for (; len < max; len *= SIZE_STEP) {
+      bench_child(kind, NULL, len);
+    }
+    bench_child(kind, NULL, max);
+    kind = strtok(NULL, ",");
+  }
+
+  for (int i = 0; i < nfiles; i++) {
+    bench_child(NULL, files[i], 0);
+  }
+  return 0;
+}
+
+//
+// This function parses through the command line arguments
+// and sets the appropriate flags for the program
+//
+// int argc:            The number of command line arguements to parse through
+// char **argv:         Char pointer holding all the arguments
+//
+void get_options(int argc, char **argv) {
+  int c = 0;
+  // Loop until all command line arguements are read
+  while ((c = getopt(argc, argv, OPTIONS)) != -1) {
+    // The largest input size in MiB
+    if (c == 'm') {
+      max_mib = strtoull(optarg, NULL, 10);
+      if (max_mib == 0) {
+        printf("Error: Largest input must be at least 1 MiB!\n");
+        exit(EXIT_FAILURE);
+      }
+      // Comma separated kinds of input to generate, empty for none
+    } else if (c == 'k') {
+      kinds = optarg;
+      // A file to benchmark as well
+    } else if (c == 'f') {
+      if (nfiles == (int)(sizeof(files) / sizeof(files[0]))) {
+        printf("Error: Too many files!\n");
+        exit(EXIT_FAILURE);
+      }
+      files[nfiles++] = optarg;
+      // The seed the corpus is generated from
+    } else if (c == 's') {
+      seed = strtoull(optarg, NULL, 0);
+      // A xorshift generator never leaves a state of zero
+      if (seed == 0) {
+        seed = 1;
+      }
+      // The code width in bits
+    } else if (c == 'w') {
+      char *end = NULL;
+      long bits = strtol(optarg, &end, 10);
+      if (end == optarg || *end != '\0' || bits < MIN_WIDTH
+          || bits > MAX_WIDTH) {
+        printf("Error: Code width must be between %d and %d bits!\n",
+            MIN_WIDTH, MAX_WIDTH);
+        exit(EXIT_FAILURE);
+      }
+      width = bits;
+      // The reset policy: full, freeze or adaptive, as adaptive:10 with a
+      // threshold percentage
+    } else if (c == 'r') {
+      char *pct = strchr(optarg, ':');
+      if (pct) {
+        *pct++ = '\0';
+        int percent = atoi(pct);
+        if (percent < 1 || percent > 100) {
+          printf("Error: Reset threshold must be between 1 and 100%%!\n");
+          exit(EXIT_FAILURE);
+        }
+        threshold = percent;
+      }
+      if (strcmp(optarg, "full") == 0) {
+        policy = RESET_FULL;
+      } else if (strcmp(optarg, "freeze") == 0) {
+        policy = RESET_FREEZE;
+      } else if (strcmp(optarg, "adaptive") == 0) {
+        policy = RESET_ADAPTIVE;
+      } else {
+        printf("Error: Reset policy must be full, freeze or adaptive!\n");
+        exit(EXIT_FAILURE);
+      }
+      // LZW codes instead of LZ78 pairs
+    } else if (c == 'l') {
+      lzw = true;
+      // Entropy coded blocks of pairs
+    } else if (c == 'e') {
+      entropy = true;
+      // CRC32C of the input after the end of the stream
+    } else if (c == 'c') {
+      checksum = true;
+    } else {
+      exit(EXIT_FAILURE);
+    }
+  }
+}
@@ -8,4 +8,25 @@
 #define START_CODE 2
 #define MAX_CODE UINT16_MAX
 
+//
+// Smallest, default and largest number of bits a code may be packed into.
+// The codes of a stream with a width of w bits run up to CODE_MAX(w), which
+// is MAX_CODE for the default width.
+//
+#define MIN_WIDTH 12
+#define DEFAULT_WIDTH 16
+#define MAX_WIDTH 24
+#define CODE_MAX(width) ((1u << (width)) - 1)
+
+//
+// This function simply identifies the minimum number
+// of bits needed for the code being passsed in
+//
+// uint32_t code:               Code of up to MAX_WIDTH bits
+//
+static inline uint8_t bit_length(uint32_t code) {
+  // The number of bits is the position of the highest bit that is on
+  return code ? 32 - __builtin_clz(code) : 0;
+}
+
 #endif
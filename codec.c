@@ -0,0 +1,1308 @@
+#include "codec.h"
+#include "crc.h"
+#include "io.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+//
+// Seeds the emptied dictionary or WordTable of an LZW Codec with every
+// single symbol, the symbol sym at the code START_CODE + sym.
+//
+// c:       Codec to seed.
+// returns: Void.
+//
+static void lzw_seed(Codec *c) {
+  for (uint32_t sym = 0; sym < 256; sym++) {
+    if (c->dict) {
+      dict_insert(c->dict, EMPTY_CODE, sym, START_CODE + sym);
+    }
+    if (c->wt) {
+      word_append_sym(c->wt, EMPTY_CODE, sym, START_CODE + sym);
+    }
+  }
+  return;
+}
+
+//
+// Primes the emptied dictionary or WordTable of a Codec with the phrases of
+// its shared dictionary, which take the codes after the first one, and
+// moves the next code past them.
+//
+// c:       Codec to prime.
+// returns: Void.
+//
+static void prime(Codec *c) {
+  uint32_t start = c->lzw ? LZW_START : START_CODE;
+  for (uint32_t i = 0; i < c->nprimes; i++) {
+    if (c->dict) {
+      dict_insert(c->dict, c->prime_codes[i], c->prime_syms[i], start + i);
+    }
+    if (c->wt) {
+      word_append_sym(c->wt, c->prime_codes[i], c->prime_syms[i], start + i);
+    }
+  }
+  c->phrase.next_code = start + c->nprimes;
+  if (c->wt) {
+    c->prime_hist = c->wt->hist_len;
+  }
+  return;
+}
+
+//
+// Allocates a Codec with empty buffers and counters.
+//
+// infile:  File descriptor of the input file.
+// outfile: File descriptor of the output file.
+// returns: Pointer to a Codec that has been allocated memory.
+//
+static Codec *codec_create(int infile, int outfile) {
+  Codec *c = (Codec *)calloc(1, sizeof(Codec));
+  if (!c) {
+    printf("Error: Failed to allocate memory for Codec!\n");
+    exit(EXIT_FAILURE);
+  }
+  c->width = DEFAULT_WIDTH;
+  c->policy = RESET_FULL;
+  c->threshold = DEFAULT_THRESHOLD;
+  c->infile = infile;
+  c->outfile = outfile;
+  c->phrase.curr_code = EMPTY_CODE;
+  c->phrase.next_code = START_CODE;
+  c->phrase.max_code = CODE_MAX(DEFAULT_WIDTH);
+
+  // Create a bit buffer will 4096 elements
+  c->bitbuf = bv_create(BLOCK * 8);
+  return c;
+}
+
+//
+// Constructor for a Codec that compresses.
+//
+// infile:  File descriptor of the uncompressed input.
+// outfile: File descriptor of the compressed output.
+// returns: Pointer to a Codec that has been allocated memory.
+//
+Codec *encoder_create(int infile, int outfile) {
+  Codec *c = codec_create(infile, outfile);
+  c->dict = dict_create(c->width);
+  return c;
+}
+
+//
+// Constructor for a Codec that decompresses.
+//
+// infile:  File descriptor of the compressed input.
+// outfile: File descriptor of the uncompressed output.
+// returns: Pointer to a Codec that has been allocated memory.
+//
+Codec *decoder_create(int infile, int outfile) {
+  Codec *c = codec_create(infile, outfile);
+  c->wt = wt_create(c->width);
+  return c;
+}
+
+//
+// Sets the number of bits of the largest code of a Codec, which is
+// DEFAULT_WIDTH for a new Codec. The dictionary or WordTable is replaced by
+// one of the new width, so this is only done before processing an input.
+//
+// c:       Codec to set the code width of.
+// width:   Number of bits, from MIN_WIDTH to MAX_WIDTH.
+// returns: Void.
+//
+void codec_set_width(Codec *c, uint8_t width) {
+  if (width == c->width) {
+    return;
+  }
+  c->width = width;
+  c->phrase.max_code = CODE_MAX(width);
+  if (c->dict) {
+    dict_delete(c->dict);
+    c->dict = dict_create(width);
+  }
+  if (c->wt) {
+    wt_delete(c->wt);
+    c->wt = wt_create(width);
+  }
+  if (c->lzw) {
+    lzw_seed(c);
+  }
+  return;
+}
+
+//
+// Sets the reset policy of a Codec, which is RESET_FULL for a new Codec.
+// A decoder has to use the policy its input was compressed with.
+//
+// c:         Codec to set the reset policy of.
+// policy:    One of RESET_FULL, RESET_FREEZE or RESET_ADAPTIVE.
+// threshold: Percentage for RESET_ADAPTIVE, only used by an encoder.
+// returns:   Void.
+//
+void codec_set_policy(Codec *c, uint8_t policy, uint8_t threshold) {
+  c->policy = policy;
+  c->threshold = threshold;
+  return;
+}
+
+//
+// Switches a Codec between LZ78, the default, and LZW. The dictionary or
+// WordTable is emptied, and seeded with every single symbol for LZW, so
+// this is only done before processing an input.
+//
+// c:       Codec to set the mode of.
+// lzw:     True for LZW, false for LZ78.
+// returns: Void.
+//
+void codec_set_lzw(Codec *c, bool lzw) {
+  c->lzw = lzw;
+  c->phrase.next_code = lzw ? LZW_START : START_CODE;
+  if (c->dict) {
+    dict_reset(c->dict);
+  }
+  if (c->wt) {
+    wt_reset(c->wt);
+  }
+  if (lzw) {
+    lzw_seed(c);
+  }
+  return;
+}
+
+//
+// Switches the entropy coding of the pairs of a Codec on or off, which is
+// off for a new Codec. With it on, pairs are gathered into blocks of up to
+// BLOCK_PAIRS pairs, and each block is written with whichever of raw codes
+// and symbols or Huffman codes of them takes fewer bits.
+//
+// c:       Codec to set the entropy coding of.
+// entropy: True to entropy code the pairs, false to pack them as they are.
+// returns: Void.
+//
+void codec_set_entropy(Codec *c, bool entropy) {
+  c->entropy = entropy;
+  if (entropy && !c->block_codes) {
+    c->block_codes = (uint32_t *)malloc(BLOCK_PAIRS * sizeof(uint32_t));
+    c->block_syms = (uint8_t *)malloc(BLOCK_PAIRS);
+    c->block_buf = (uint8_t *)malloc(BLOCK_BYTES);
+    if (!c->block_codes || !c->block_syms || !c->block_buf) {
+      printf("Error: Failed to allocate memory for Codec blocks!\n");
+      exit(EXIT_FAILURE);
+    }
+  }
+  c->block_len = 0;
+  c->block_pos = 0;
+  return;
+}
+
+//
+// Switches the checksum of a Codec on or off, which is off for a new Codec.
+// With it on, an encoder adds a CRC32C of its input after the end of the
+// stream, and a decoder checks the CRC32C of its output against it.
+//
+// c:         Codec to set the checksum of.
+// checksum:  True to write or check a checksum, false for none.
+// returns:   Void.
+//
+void codec_set_checksum(Codec *c, bool checksum) {
+  c->checksum = checksum;
+  c->crc = 0;
+  return;
+}
+
+//
+// Sets the shared dictionary of a Codec, which is none for a new Codec.
+// The dictionary is parsed into phrases over and over, each pass adding
+// longer ones, until a quarter of the codes of the width are taken. The
+// dictionary or WordTable is primed with those phrases for every input, so
+// this is only done after the width and mode are set and before processing
+// an input. A reset within an input starts over from empty as before.
+//
+// c:       Codec to set the shared dictionary of.
+// shared:  Bytes of the shared dictionary, NULL for none. Not copied.
+// len:     Number of bytes of the shared dictionary.
+// returns: Void.
+//
+void codec_set_shared(Codec *c, const uint8_t *shared, uint32_t len) {
+  uint32_t start = c->lzw ? LZW_START : START_CODE;
+  uint32_t limit = (c->phrase.max_code - start) / 4;
+  c->shared = shared;
+  c->shared_len = shared ? len : 0;
+  c->shared_id = shared ? crc32c(0, shared, len) : 0;
+  c->nprimes = 0;
+  c->prime_codes = (uint32_t *)realloc(c->prime_codes,
+      limit * sizeof(uint32_t));
+  c->prime_syms = (uint8_t *)realloc(c->prime_syms, limit);
+  if (!c->prime_codes || !c->prime_syms) {
+    printf("Error: Failed to allocate memory for shared dictionary!\n");
+    exit(EXIT_FAILURE);
+  }
+
+  // Parse the dictionary the way an encoder would with a Dict of its own,
+  // starting each pass from the empty phrase, until a pass adds nothing
+  Dict *d = dict_create(c->width);
+  if (c->lzw) {
+    for (uint32_t sym = 0; sym < 256; sym++) {
+      dict_insert(d, EMPTY_CODE, sym, START_CODE + sym);
+    }
+  }
+  uint32_t added = c->shared_len;
+  while (added && c->nprimes < limit) {
+    added = 0;
+    uint32_t curr = EMPTY_CODE;
+    for (uint32_t i = 0; i < c->shared_len && c->nprimes < limit; i++) {
+      uint8_t sym = c->shared[i];
+      uint32_t step = dict_step(d, curr, sym);
+      if (step != STOP_CODE) {
+        curr = step;
+        continue;
+      }
+      c->prime_codes[c->nprimes] = curr;
+      c->prime_syms[c->nprimes] = sym;
+      dict_insert(d, curr, sym, start + c->nprimes);
+      c->nprimes++;
+      added++;
+      curr = c->lzw ? START_CODE + sym : EMPTY_CODE;
+    }
+  }
+  dict_delete(d);
+
+  // An LZW decoder reads the first code with the bits of the first free
+  // code, and the encoder packs it into the bits of the code before that,
+  // which only agree while the first free code isn't a power of two
+  uint32_t first = start + c->nprimes;
+  if (c->lzw && (first & (first - 1)) == 0) {
+    c->nprimes--;
+  }
+
+  // Start the first input over with the primed phrases
+  if (c->dict) {
+    dict_reset(c->dict);
+  }
+  if (c->wt) {
+    wt_reset(c->wt);
+  }
+  if (c->lzw) {
+    lzw_seed(c);
+  }
+  prime(c);
+  return;
+}
+
+//
+// Destructor for a Codec.
+// The file descriptors of the Codec are not closed.
+//
+// c:       Codec to free allocated memory for.
+// returns: Void.
+//
+void codec_delete(Codec *c) {
+  if (c->dict) {
+    dict_delete(c->dict);
+  }
+  if (c->wt) {
+    wt_delete(c->wt);
+  }
+  bv_delete(c->bitbuf);
+  free(c->block_codes);
+  free(c->block_syms);
+  free(c->block_buf);
+  free(c->prime_codes);
+  free(c->prime_syms);
+  free(c->out_mem);
+  free(c);
+  return;
+}
+
+//
+// Resets a Codec so that it can process another input from the start.
+// Buffers, counters and the dictionary or WordTable are emptied.
+// Memory input and output are rewound but not freed.
+//
+// c:       Codec to reset.
+// returns: Void.
+//
+void codec_reset(Codec *c) {
+  // An input that never reset the dictionary left the primed phrases where
+  // they were, so only its own phrases have to be taken back out
+  bool rewind = c->nprimes && c->resets == 0;
+  c->byte_count = 0;
+  c->rbytes = 0;
+  c->bit_index = 0;
+  c->bit_acc = 0;
+  c->acc_bits = 0;
+  c->total_syms = 0;
+  c->total_bits = 0;
+  c->resets = 0;
+  c->in_pos = 0;
+  c->out_len = 0;
+  c->phrase.curr_code = EMPTY_CODE;
+  c->phrase.prev_code = STOP_CODE;
+  c->phrase.next_code = c->lzw ? LZW_START : START_CODE;
+  c->phrase.prev_sym = 0;
+  c->phrase.len = 0;
+  c->monitor.syms = 0;
+  c->monitor.bits = 0;
+  c->monitor.best = 0;
+  c->block_len = 0;
+  c->block_pos = 0;
+  c->crc = 0;
+
+  // Clear the bit buffer so the unused bits of the last byte of a stream
+  // don't depend on what the Codec processed before
+  memset(c->bitbuf->vector, 0, BLOCK + 1);
+
+  uint32_t primed = (c->lzw ? 256 : 0) + c->nprimes;
+  if (rewind && (!c->dict || dict_rewind(c->dict, primed))) {
+    if (c->wt) {
+      wt_rewind(c->wt, c->prime_hist);
+    }
+    c->phrase.next_code += c->nprimes;
+    return;
+  }
+  if (c->dict) {
+    dict_reset(c->dict);
+  }
+  if (c->wt) {
+    wt_reset(c->wt);
+  }
+  if (c->lzw) {
+    lzw_seed(c);
+  }
+  prime(c);
+  return;
+}
+
+//
+// Struct definition of a Pair, the code and symbol of a phrase that ended
+// along with the number of bits the code is packed into. LZW only uses the
+// code, which a reset code may follow.
+//
+typedef struct Pair {
+  uint32_t code;
+  uint8_t sym;
+  uint8_t bit_len;
+  bool reset;
+} Pair;
+
+//
+// Works out the code after the one of a pair, the same way for an encoder
+// and a decoder. A dictionary that fills up is emptied straight away with
+// RESET_FULL, otherwise it stays full until a pair with the largest code
+// resets it, and the symbol of that pair takes START_CODE.
+//
+// policy:    Reset policy of the Codec.
+// next_code: Code the pair was assigned, max_code if the dictionary is full.
+// max_code:  Largest code of the width.
+// code:      Code of the pair.
+// returns:   Code the next pair is assigned.
+//
+static inline uint32_t code_after(uint8_t policy, uint32_t next_code,
+    uint32_t max_code, uint32_t code) {
+  if (next_code == max_code) {
+    return code == max_code ? START_CODE + 1 : max_code;
+  }
+  next_code++;
+  return next_code == max_code && policy == RESET_FULL ? START_CODE : next_code;
+}
+
+//
+// Counts a phrase of a full dictionary towards the window of the Monitor of
+// an encoder with RESET_ADAPTIVE, and tells whether the dictionary is due a
+// reset once the window is complete, which starts the Monitor over.
+//
+// c:       Codec that compresses.
+// len:     Number of symbols in the phrase.
+// bits:    Number of bits written for the phrase.
+// returns: True if the dictionary should be reset.
+//
+static bool monitor_reset(Codec *c, uint32_t len, uint32_t bits) {
+  Monitor *m = &c->monitor;
+  m->syms += len;
+  m->bits += bits;
+  if (m->syms < ADAPT_WINDOW) {
+    return false;
+  }
+  double bpb = (double)m->bits / m->syms;
+  m->syms = 0;
+  m->bits = 0;
+  // A window that isn't compressed at all is reset on too, since a
+  // dictionary that only fits earlier input never gets a better window
+  if (bpb >= 8 || (m->best && bpb > m->best * (100 + c->threshold) / 100)) {
+    m->best = 0;
+    return true;
+  }
+  if (m->best == 0 || bpb < m->best) {
+    m->best = bpb;
+  }
+  return false;
+}
+
+//
+// Handles a phrase of an encoder that ended once its dictionary is full,
+// which only happens with RESET_FREEZE and RESET_ADAPTIVE. Nothing is added
+// to a full dictionary. With RESET_ADAPTIVE the phrase counts towards the
+// window of the Monitor, and once a window compresses worse than the
+// threshold allows or not at all, the next phrase starts at the largest code
+// so that the pair of the next symbol signals the reset.
+// The Phrase is not passed in, so the caller can keep it in registers.
+//
+// c:       Codec that compresses.
+// code:    Code of the pair of the phrase, the largest code for a reset.
+// len:     Number of symbols in the phrase.
+// sym:     Symbol that ended the phrase.
+// bit_len: Number of bits the code of the phrase is packed into.
+// returns: Code the next phrase starts at.
+//
+static uint32_t encode_full(Codec *c, uint32_t code, uint32_t len,
+    uint8_t sym, uint8_t bit_len) {
+  if (code == c->phrase.max_code) {
+    // The pair signalled the reset, its symbol starts the new dictionary
+    dict_reset(c->dict);
+    c->resets++;
+    dict_insert(c->dict, EMPTY_CODE, sym, START_CODE);
+    return EMPTY_CODE;
+  }
+  if (c->policy == RESET_ADAPTIVE && monitor_reset(c, len, bit_len + 8)) {
+    return c->phrase.max_code;
+  }
+  return EMPTY_CODE;
+}
+
+//
+// Steps the phrase an encoder has matched so far with one more symbol.
+// When the extended phrase is new, it is added to the dictionary and its
+// pair is returned for the caller to buffer.
+// Callers pass a local copy of the Phrase of the Codec, which the compiler
+// can keep in registers for the whole loop.
+//
+// c:       Codec that compresses.
+// p:       Phrase matched so far.
+// sym:     Symbol to step with.
+// pair:    Pair to store the pair of a new phrase into.
+// returns: True if the phrase ended and pair was stored, false otherwise.
+//
+static inline bool encode_sym(Codec *c, Phrase *p, uint8_t sym, Pair *pair) {
+  bool ended = false;
+  p->len++;
+  // Look up the code of the current phrase extended by the current symbol
+  uint32_t step_code = dict_step(c->dict, p->curr_code, sym);
+
+  // Check if that phrase exists
+  if (step_code != STOP_CODE) {
+    p->prev_code = p->curr_code;
+    p->curr_code = step_code;
+  } else {
+    // Hand the current symbol back with its corresponding code
+    pair->code = p->curr_code;
+    pair->sym = sym;
+    pair->bit_len = bit_length(p->next_code);
+    pair->reset = false;
+    ended = true;
+    if (p->next_code == p->max_code) {
+      if (p->curr_code == p->max_code) {
+        p->next_code = START_CODE + 1;
+      }
+      p->curr_code = encode_full(c, pair->code, p->len, sym, pair->bit_len);
+    } else {
+      dict_insert(c->dict, p->curr_code, sym, p->next_code);
+      p->curr_code = EMPTY_CODE;
+      p->next_code = p->next_code + 1;
+      // Check if the code is at the largest code of the width, and if so
+      // reset the dictionary unless it is kept once full
+      if (p->next_code == p->max_code && c->policy == RESET_FULL) {
+        dict_reset(c->dict);
+        c->resets++;
+        p->next_code = START_CODE;
+      }
+    }
+    p->len = 0;
+  }
+  p->prev_sym = sym;
+  return ended;
+}
+
+//
+// Steps the phrase an LZW encoder has matched so far with one more symbol,
+// like encode_sym(). Every single symbol is in the dictionary, so a phrase
+// that can't be extended ends before the symbol, which starts the next
+// phrase, and only the code of the phrase is handed back. The decoder adds
+// a phrase one code later than the encoder, so the code is packed into as
+// many bits as the last code added takes.
+//
+// c:       Codec that compresses with LZW.
+// p:       Phrase matched so far.
+// sym:     Symbol to step with.
+// pair:    Pair to store the code of a phrase that ended into.
+// returns: True if the phrase ended and pair was stored, false otherwise.
+//
+static inline bool lzw_encode_sym(Codec *c, Phrase *p, uint8_t sym,
+    Pair *pair) {
+  uint32_t step_code = dict_step(c->dict, p->curr_code, sym);
+  if (step_code != STOP_CODE) {
+    p->curr_code = step_code;
+    p->len++;
+    return false;
+  }
+  pair->code = p->curr_code;
+  pair->sym = 0;
+  pair->bit_len = bit_length(p->next_code - 1);
+  pair->reset = false;
+  if (p->next_code != p->max_code) {
+    dict_insert(c->dict, p->curr_code, sym, p->next_code);
+    p->next_code++;
+  } else if (c->policy == RESET_FULL
+             || (c->policy == RESET_ADAPTIVE
+                 && monitor_reset(c, p->len, pair->bit_len))) {
+    // A full dictionary is reset after its last code is handed back, and
+    // with RESET_ADAPTIVE a reset code after it tells the decoder so
+    pair->reset = c->policy == RESET_ADAPTIVE;
+    dict_reset(c->dict);
+    lzw_seed(c);
+    c->resets++;
+    p->next_code = LZW_START;
+  }
+  p->curr_code = START_CODE + sym;
+  p->len = 1;
+  return true;
+}
+
+//
+// Buffers the code of an LZW Pair, and the reset code after it if any.
+//
+// c:       Codec that compresses with LZW.
+// pair:    Pair to buffer.
+// returns: Void.
+//
+static inline void lzw_buffer(Codec *c, Pair *pair) {
+  buffer_code(c, pair->code, pair->bit_len);
+  if (pair->reset) {
+    buffer_code(c, c->phrase.max_code, pair->bit_len);
+  }
+  return;
+}
+
+//
+// Adds a Pair to the block of an entropy coding Codec, with the reset code
+// after it as a pair of its own if any, and buffers the block once full.
+//
+// c:       Codec that compresses with entropy coding.
+// pair:    Pair to add.
+// returns: Void.
+//
+static inline void block_add(Codec *c, Pair *pair) {
+  c->block_codes[c->block_len] = pair->code;
+  c->block_syms[c->block_len++] = pair->sym;
+  if (pair->reset) {
+    c->block_codes[c->block_len] = c->phrase.max_code;
+    c->block_syms[c->block_len++] = 0;
+  }
+  if (c->block_len >= BLOCK_PAIRS - 1) {
+    buffer_block(c, c->block_codes, c->block_syms, c->block_len);
+    c->block_len = 0;
+  }
+  return;
+}
+
+//
+// Finishes an entropy coded compression by buffering the last block, the
+// empty block that ends the stream, the checksum if any and any bits left
+// in the buffer.
+//
+// c:       Codec that compresses with entropy coding.
+// returns: Void.
+//
+static void block_finish(Codec *c) {
+  if (c->block_len) {
+    buffer_block(c, c->block_codes, c->block_syms, c->block_len);
+    c->block_len = 0;
+  }
+  buffer_block(c, NULL, NULL, 0);
+  if (c->checksum) {
+    buffer_checksum(c);
+  }
+  flush_pairs(c);
+  return;
+}
+
+//
+// Counts a phrase in the CodecStats of a Codec, and writes a trace sample
+// once every so many phrases if tracing.
+//
+// c:         Codec the phrase belongs to, with CodecStats.
+// len:       Number of symbols in the phrase.
+// bits:      Number of bits written for the phrase.
+// next_code: Next code after the phrase was added to the dictionary.
+// returns:   Void.
+//
+static inline void stats_phrase(Codec *c, uint32_t len, uint32_t bits,
+    uint32_t next_code) {
+  CodecStats *st = c->stats;
+  st->phrases++;
+  st->phrase_syms += len;
+  if (len > st->max_phrase) {
+    st->max_phrase = len;
+  }
+  if (st->trace) {
+    st->window_syms += len;
+    st->window_bits += bits;
+    if (--st->trace_left == 0) {
+      stats_trace(st, next_code, bit_length(next_code), c->resets,
+          c->wt ? c->wt->hist_len : 0);
+    }
+  }
+  return;
+}
+
+//
+// Compresses an array of symbols like codec_encode_syms(), timing the
+// dictionary and the bit packing apart for the CodecStats of the Codec.
+// A block of symbols is matched against the dictionary first, collecting
+// the pairs of the phrases that end, and then the pairs are packed. The
+// same pairs are buffered in the same order, so the output is unchanged.
+//
+// c:       Codec that compresses, with CodecStats.
+// syms:    Array of symbols to compress.
+// len:     Number of symbols in the array.
+// returns: Void.
+//
+static void encode_timed(Codec *c, const uint8_t *syms, uint64_t len) {
+  CodecStats *st = c->stats;
+  Pair pairs[BLOCK];
+  Phrase p = c->phrase;
+  for (uint64_t off = 0; off < len; off += BLOCK) {
+    uint64_t n = len - off < BLOCK ? len - off : BLOCK;
+    uint32_t npairs = 0;
+    Clock t;
+    clock_now(&t);
+    for (uint64_t i = 0; i < n; i++) {
+      Pair *pair = &pairs[npairs];
+      if (c->lzw) {
+        // The symbol that ends an LZW phrase is not part of it
+        uint32_t phrase_len = p.len;
+        if (lzw_encode_sym(c, &p, syms[off + i], pair)) {
+          stats_phrase(c, phrase_len, pair->bit_len * (pair->reset ? 2 : 1),
+              p.next_code);
+          npairs++;
+        }
+      } else {
+        uint32_t phrase_len = p.len + 1;
+        if (encode_sym(c, &p, syms[off + i], pair)) {
+          stats_phrase(c, phrase_len, pair->bit_len + 8, p.next_code);
+          npairs++;
+        }
+      }
+    }
+    clock_add(&st->dict, &t);
+
+    Clock w = st->write;
+    clock_now(&t);
+    for (uint32_t i = 0; i < npairs; i++) {
+      if (c->entropy) {
+        block_add(c, &pairs[i]);
+      } else if (c->lzw) {
+        lzw_buffer(c, &pairs[i]);
+      } else {
+        buffer_pair(c, pairs[i].code, pairs[i].sym, pairs[i].bit_len);
+      }
+    }
+    clock_add(&st->pack, &t);
+    clock_exclude(&st->pack, &st->write, &w);
+
+    // The dictionary is only reset once it holds every code
+    if (c->resets || p.next_code == p.max_code) {
+      st->peak_entries = p.max_code - START_CODE;
+    } else if (c->dict->count > st->peak_entries) {
+      st->peak_entries = c->dict->count;
+    }
+  }
+  st->peak_bytes = (c->dict->mask + 1) * sizeof(DictEntry);
+  c->phrase = p;
+  return;
+}
+
+//
+// Compresses an array of symbols with a Codec.
+// Pairs are written to the output file as phrases end, but the phrase the
+// last symbols belong to is kept so that the next call can extend it.
+//
+// c:       Codec that compresses.
+// syms:    Array of symbols to compress.
+// len:     Number of symbols in the array.
+// returns: Void.
+//
+void codec_encode_syms(Codec *c, const uint8_t *syms, uint64_t len) {
+  c->total_syms += len;
+  if (c->checksum) {
+    c->crc = crc32c(c->crc, syms, len);
+  }
+  if (c->stats) {
+    encode_timed(c, syms, len);
+    return;
+  }
+  Phrase p = c->phrase;
+  Pair pair = { 0, 0, 0, false };
+  // Loop through the symbols directly, there is no buffer to refill
+  if (c->entropy) {
+    // The pairs are gathered into blocks that are coded once full
+    for (uint64_t i = 0; i < len; i++) {
+      bool ended = c->lzw ? lzw_encode_sym(c, &p, syms[i], &pair)
+                          : encode_sym(c, &p, syms[i], &pair);
+      if (ended) {
+        block_add(c, &pair);
+      }
+    }
+  } else if (c->lzw) {
+    for (uint64_t i = 0; i < len; i++) {
+      if (lzw_encode_sym(c, &p, syms[i], &pair)) {
+        lzw_buffer(c, &pair);
+      }
+    }
+  } else {
+    for (uint64_t i = 0; i < len; i++) {
+      if (encode_sym(c, &p, syms[i], &pair)) {
+        buffer_pair(c, pair.code, pair.sym, pair.bit_len);
+      }
+    }
+  }
+  c->phrase = p;
+  return;
+}
+
+//
+// Finishes an LZW compression by writing out the code of the last phrase,
+// the STOP_CODE, the checksum if any and any bits left in the buffer. The
+// STOP_CODE is packed into as many bits as the decoder reads it with once
+// it has added the last phrase, or reset its WordTable after it.
+//
+// c:       Codec that compresses with LZW.
+// returns: Void.
+//
+static void lzw_encode_finish(Codec *c) {
+  Phrase *p = &c->phrase;
+  if (p->curr_code != EMPTY_CODE) {
+    uint8_t bit_len = bit_length(p->next_code - 1);
+    if (c->entropy) {
+      Pair pair = { p->curr_code, 0, bit_len, false };
+      block_add(c, &pair);
+    } else {
+      buffer_code(c, p->curr_code, bit_len);
+    }
+    if (c->stats) {
+      stats_phrase(c, p->len, bit_len, p->next_code);
+    }
+  }
+  if (c->entropy) {
+    block_finish(c);
+    return;
+  }
+  uint32_t next_code = p->next_code;
+  if (next_code == p->max_code && c->policy == RESET_FULL) {
+    next_code = LZW_START;
+  }
+  buffer_code(c, STOP_CODE, bit_length(next_code));
+  if (c->checksum) {
+    buffer_checksum(c);
+  }
+  flush_pairs(c);
+  return;
+}
+
+//
+// Finishes a compression by writing out the pair of the last phrase, the
+// STOP_CODE, the checksum if any and any bits left in the buffer.
+//
+// c:       Codec that compresses.
+// returns: Void.
+//
+void codec_encode_finish(Codec *c) {
+  if (c->lzw) {
+    lzw_encode_finish(c);
+    return;
+  }
+  Phrase *p = &c->phrase;
+  // A phrase at the largest code is a reset that no symbol followed
+  if (p->curr_code != EMPTY_CODE && p->curr_code != p->max_code) {
+    uint8_t bit_len = bit_length(p->next_code);
+    if (c->entropy) {
+      Pair pair = { p->prev_code, p->prev_sym, bit_len, false };
+      block_add(c, &pair);
+    } else {
+      buffer_pair(c, p->prev_code, p->prev_sym, bit_len);
+    }
+    p->next_code = code_after(c->policy, p->next_code, p->max_code,
+        p->prev_code);
+    if (c->stats) {
+      stats_phrase(c, p->len, bit_len + 8, p->next_code);
+    }
+  }
+
+  if (c->entropy) {
+    block_finish(c);
+    return;
+  }
+
+  // Put the STOP_CODE value with no symbol to signify the end of the buffer/file
+  buffer_pair(c, STOP_CODE, 0, bit_length(p->next_code));
+  if (c->checksum) {
+    buffer_checksum(c);
+  }
+  // Flush any remaining bits from the buffer into the oufile
+  flush_pairs(c);
+  return;
+}
+
+//
+// Compresses everything left in the input file of a Codec.
+// Pairs are written to the output file up to and including the STOP_CODE.
+// If the infile is MEM_FD, the memory input is compressed in place.
+// The FileHeader is not written.
+//
+// c:       Codec that compresses.
+// returns: Void.
+//
+void codec_encode(Codec *c) {
+  if (c->infile == MEM_FD) {
+    // Walk the memory input without copying it into the buffer
+    codec_encode_syms(c, c->in_mem + c->in_pos, c->in_len - c->in_pos);
+    c->in_pos = c->in_len;
+  } else if (c->stats || c->lzw || c->entropy) {
+    // Read a block at a time so each block is timed as a whole, or to go
+    // through the LZW or entropy coding loops of codec_encode_syms()
+    int n = 0;
+    while ((n = read_bytes(c, c->buffer, BLOCK)) > 0) {
+      codec_encode_syms(c, c->buffer, n);
+    }
+  } else {
+    // Loop until there is no symbols left to process
+    Phrase p = c->phrase;
+    Pair pair;
+    uint8_t curr_sym = 0;
+    while (read_sym(c, &curr_sym)) {
+      if (encode_sym(c, &p, curr_sym, &pair)) {
+        buffer_pair(c, pair.code, pair.sym, pair.bit_len);
+      }
+    }
+    c->phrase = p;
+  }
+  codec_encode_finish(c);
+  return;
+}
+
+//
+// Decompresses a single pair into the output of a decoder. A pair adds its
+// Word to the WordTable, except once the WordTable is full and frozen, where
+// the Word of its code is written out followed by its symbol, until a pair
+// with the largest code resets it.
+//
+// c:         Codec that decompresses.
+// code:      Code of the pair.
+// sym:       Symbol of the pair.
+// next_code: Code the pair is assigned, updated to the code of the next pair.
+// returns:   Number of symbols written, zero if the pair refers to a code
+//            that doesn't exist yet.
+//
+static inline uint32_t decode_pair(Codec *c, uint32_t code, uint8_t sym,
+    uint32_t *next_code) {
+  uint32_t max_code = c->phrase.max_code;
+  if (*next_code == max_code) {
+    if (code != max_code) {
+      Word *word = &c->wt->words[code];
+      buffer_word(c, word);
+      buffer_sym(c, sym);
+      return word->len + 1;
+    }
+    // The encoder reset its dictionary, the symbol starts the new one
+    wt_reset(c->wt);
+    c->resets++;
+    *next_code = START_CODE;
+    code = EMPTY_CODE;
+  }
+  // A pair can only refer to a word that has already been decoded
+  if (code >= *next_code) {
+    return 0;
+  }
+  // Puts a new word or an appended word into the wordtable
+  Word *word = word_append_sym(c->wt, code, sym, *next_code);
+  // Buffer the word into the symbol buffer
+  buffer_word(c, word);
+  (*next_code)++;
+  // If code reaches its max value reset the word table and next_code,
+  // unless the word table is kept once full
+  if (*next_code == max_code && c->policy == RESET_FULL) {
+    wt_reset(c->wt);
+    c->resets++;
+    *next_code = START_CODE;
+  }
+  return word->len;
+}
+
+//
+// Works out the state of an LZW decoder after a code, without decoding it,
+// the same way lzw_decode_code() does: the first code after the start or a
+// reset adds no word, every other code adds one until the WordTable is full,
+// and a full WordTable is reset straight away with RESET_FULL or by the
+// largest code otherwise.
+//
+// policy:  Reset policy of the Codec.
+// p:       Next code and last code of the decoder, updated.
+// code:    Code that was read.
+// returns: Void.
+//
+static inline void lzw_code_after(uint8_t policy, Phrase *p, uint32_t code) {
+  if (p->prev_code == STOP_CODE) {
+    p->prev_code = code;
+    return;
+  }
+  if (p->next_code == p->max_code) {
+    if (code == p->max_code) {
+      p->next_code = LZW_START;
+      p->prev_code = STOP_CODE;
+    }
+    return;
+  }
+  p->next_code++;
+  p->prev_code = code;
+  if (p->next_code == p->max_code && policy == RESET_FULL) {
+    p->next_code = LZW_START;
+    p->prev_code = STOP_CODE;
+  }
+  return;
+}
+
+//
+// Decompresses a single code of an LZW stream. Each code but the first after
+// the start or a reset adds the Word of the code before it followed by the
+// first symbol of its own Word. The code may be the Word being added, the
+// case of a phrase followed by itself, and then its first symbol is the
+// first symbol of the Word before it.
+//
+// c:       Codec that decompresses with LZW.
+// p:       Next code and last code of the decoder, updated.
+// code:    Code that was read.
+// len:     Pointer to memory which stores the number of symbols written.
+// returns: False if the code doesn't exist yet, true otherwise.
+//
+static inline bool lzw_decode_code(Codec *c, Phrase *p, uint32_t code,
+    uint32_t *len) {
+  WordTable *wt = c->wt;
+  *len = 0;
+  if (code < START_CODE) {
+    return false;
+  }
+  if (p->prev_code == STOP_CODE) {
+    // The first code only has the single symbols and primed phrases to
+    // refer to
+    if (code >= p->next_code) {
+      return false;
+    }
+  } else if (p->next_code == p->max_code) {
+    // A full WordTable is kept until the encoder signals a reset
+    if (code == p->max_code) {
+      wt_reset(wt);
+      lzw_seed(c);
+      c->resets++;
+      p->next_code = LZW_START;
+      p->prev_code = STOP_CODE;
+      return true;
+    }
+  } else {
+    if (code > p->next_code) {
+      return false;
+    }
+    Word *first = code == p->next_code ? &wt->words[p->prev_code]
+                                       : &wt->words[code];
+    word_append_sym(wt, p->prev_code, *word_syms(wt, first), p->next_code);
+    p->next_code++;
+  }
+  Word *word = &wt->words[code];
+  buffer_word(c, word);
+  *len = word->len;
+  p->prev_code = code;
+  if (p->next_code == p->max_code && c->policy == RESET_FULL) {
+    wt_reset(wt);
+    lzw_seed(c);
+    c->resets++;
+    p->next_code = LZW_START;
+    p->prev_code = STOP_CODE;
+  }
+  return true;
+}
+
+//
+// Decompresses a pair read from a block of an entropy coded stream, with
+// LZW or LZ78 as the Codec uses.
+//
+// c:       Codec that decompresses with entropy coding.
+// p:       Next code and last code of the decoder, updated.
+// code:    Code of the pair.
+// sym:     Symbol of the pair, unused by LZW.
+// len:     Pointer to memory which stores the number of symbols written.
+// returns: False if the pair refers to a code that doesn't exist yet, true
+//          otherwise.
+//
+static inline bool decode_block_pair(Codec *c, Phrase *p, uint32_t code,
+    uint8_t sym, uint32_t *len) {
+  if (c->lzw) {
+    return lzw_decode_code(c, p, code, len);
+  }
+  *len = decode_pair(c, code, sym, &p->next_code);
+  return *len != 0;
+}
+
+//
+// Finishes a decompression by writing out the symbols left in the buffer,
+// and then checks the checksum after the end of the stream if any.
+//
+// c:       Codec that decompresses.
+// returns: Void.
+//
+static void decode_finish(Codec *c) {
+  flush_words(c);
+  if (c->checksum && !read_checksum(c)) {
+    printf("Error: Checksum mismatch in infile!\n");
+    exit(EXIT_FAILURE);
+  }
+  return;
+}
+
+//
+// Decompresses like codec_decode(), timing the bit unpacking and the word
+// table apart for the CodecStats of the Codec.
+// A block of pairs is unpacked first and then their words are appended
+// and buffered.
+//
+// c:       Codec that decompresses, with CodecStats.
+// returns: Void.
+//
+static void decode_timed(Codec *c) {
+  CodecStats *st = c->stats;
+  uint32_t block_codes[BLOCK];
+  uint8_t block_syms[BLOCK];
+  uint8_t block_bits[BLOCK];
+  uint32_t *codes = c->entropy ? c->block_codes : block_codes;
+  uint8_t *syms = c->entropy ? c->block_syms : block_syms;
+  Phrase p = c->phrase;
+  uint32_t max_code = p.max_code;
+  bool done = false;
+
+  while (!done) {
+    // The codes a block of pairs is packed with only depend on the codes
+    // that came before, so the block can be unpacked on its own
+    Phrase ahead = p;
+    uint32_t npairs = 0;
+    Clock r = st->read;
+    Clock t;
+    clock_now(&t);
+    uint64_t block_start = c->total_bits;
+    if (c->entropy) {
+      int result = read_block(c, codes, syms, &npairs);
+      if (result == DECODE_CORRUPT) {
+        printf("Error: Corrupted block in infile!\n");
+        exit(EXIT_FAILURE);
+      }
+      done = result == DECODE_DONE;
+    }
+    while (!c->entropy && npairs < BLOCK) {
+      uint8_t bit_len = bit_length(ahead.next_code);
+      if (c->lzw) {
+        if (!read_code(c, &codes[npairs], bit_len)) {
+          done = true;
+          break;
+        }
+        lzw_code_after(c->policy, &ahead, codes[npairs]);
+      } else {
+        if (!read_pair(c, &codes[npairs], &syms[npairs], bit_len)) {
+          done = true;
+          break;
+        }
+        ahead.next_code = code_after(c->policy, ahead.next_code, max_code,
+            codes[npairs]);
+        bit_len += 8;
+      }
+      block_bits[npairs++] = bit_len;
+    }
+    // A block only has the bits of all its pairs together
+    uint64_t pair_bits = npairs ? (c->total_bits - block_start) / npairs : 0;
+    clock_add(&st->pack, &t);
+    clock_exclude(&st->pack, &st->read, &r);
+
+    Clock w = st->write;
+    clock_now(&t);
+    for (uint32_t i = 0; i < npairs; i++) {
+      uint32_t len = 0;
+      uint32_t bits = c->entropy ? pair_bits : block_bits[i];
+      if (c->lzw) {
+        if (!lzw_decode_code(c, &p, codes[i], &len)) {
+          printf("Error: Corrupted code in infile!\n");
+          exit(EXIT_FAILURE);
+        }
+      } else {
+        len = decode_pair(c, codes[i], syms[i], &p.next_code);
+        if (len == 0) {
+          printf("Error: Corrupted pair in infile!\n");
+          exit(EXIT_FAILURE);
+        }
+      }
+      stats_phrase(c, len, bits, p.next_code);
+    }
+    clock_add(&st->dict, &t);
+    clock_exclude(&st->dict, &st->write, &w);
+
+    if (c->resets || p.next_code == max_code) {
+      st->peak_entries = max_code - START_CODE;
+    } else if (p.next_code - START_CODE > st->peak_entries) {
+      st->peak_entries = p.next_code - START_CODE;
+    }
+  }
+  decode_finish(c);
+  st->peak_bytes = max_code * sizeof(Word) + c->wt->hist_cap;
+  c->phrase = p;
+  return;
+}
+
+//
+// Decompresses the pairs in the input file of a Codec up to the STOP_CODE.
+// The FileHeader must already have been read.
+//
+// c:       Codec that decompresses.
+// returns: Void.
+//
+void codec_decode(Codec *c) {
+  if (c->stats) {
+    decode_timed(c);
+    return;
+  }
+  uint8_t curr_sym = 0;
+  uint32_t curr_code = 0;
+  uint32_t next_code = c->phrase.next_code;
+
+  if (c->entropy) {
+    // Loop until the empty block, decompressing a whole block at a time
+    Phrase p = c->phrase;
+    uint32_t npairs = 0;
+    uint32_t len = 0;
+    int result = DECODE_MORE;
+    while ((result = read_block(c, c->block_codes, c->block_syms, &npairs))
+           == DECODE_MORE) {
+      for (uint32_t i = 0; i < npairs; i++) {
+        if (!decode_block_pair(c, &p, c->block_codes[i], c->block_syms[i],
+                &len)) {
+          result = DECODE_CORRUPT;
+          break;
+        }
+      }
+      if (result == DECODE_CORRUPT) {
+        break;
+      }
+    }
+    if (result == DECODE_CORRUPT) {
+      printf("Error: Corrupted block in infile!\n");
+      exit(EXIT_FAILURE);
+    }
+    decode_finish(c);
+    c->phrase = p;
+    return;
+  }
+
+  if (c->lzw) {
+    // Loop until the STOP_CODE, with the state of the decoder kept local
+    Phrase p = c->phrase;
+    uint32_t len = 0;
+    while (read_code(c, &curr_code, bit_length(p.next_code))) {
+      if (!lzw_decode_code(c, &p, curr_code, &len)) {
+        printf("Error: Corrupted code in infile!\n");
+        exit(EXIT_FAILURE);
+      }
+    }
+    decode_finish(c);
+    c->phrase = p;
+    return;
+  }
+
+  // Loop until there are no more bits to procress in the read buffer
+  while (read_pair(c, &curr_code, &curr_sym, bit_length(next_code))) {
+    if (!decode_pair(c, curr_code, curr_sym, &next_code)) {
+      printf("Error: Corrupted pair in infile!\n");
+      exit(EXIT_FAILURE);
+    }
+  }
+  // Flush any remaining symbols from the buffer into the oufile
+  decode_finish(c);
+  return;
+}
+
+//
+// Decompresses as many pairs of the memory input of a Codec as have all of
+// their bits in it. The word table and next code are kept in the Codec, so
+// the next call carries on where this one stopped once more input is added.
+// Decompression also stops once limit bytes of output are in out_mem.
+//
+// c:       Codec that decompresses from memory.
+// limit:   Number of bytes in out_mem at which to stop.
+// returns: DECODE_DONE once the STOP_CODE is read, DECODE_CORRUPT if a
+//          pair refers to a code that doesn't exist yet, else DECODE_MORE.
+//
+int codec_decode_syms(Codec *c, uint64_t limit) {
+  uint8_t curr_sym = 0;
+  uint32_t curr_code = 0;
+  uint32_t len = 0;
+  Phrase p = c->phrase;
+  int result = DECODE_MORE;
+
+  // Loop until the output limit is reached or a pair is only partly read in,
+  // or for entropy coding until the block after the last one decompressed
+  // is only partly read in
+  while (c->entropy && c->out_len < limit) {
+    if (c->block_pos == c->block_len) {
+      if (!block_buffered(c)) {
+        break;
+      }
+      result = read_block(c, c->block_codes, c->block_syms, &c->block_len);
+      c->block_pos = 0;
+      if (result != DECODE_MORE) {
+        break;
+      }
+    }
+    uint32_t i = c->block_pos++;
+    if (!decode_block_pair(c, &p, c->block_codes[i], c->block_syms[i],
+            &len)) {
+      result = DECODE_CORRUPT;
+      break;
+    }
+  }
+  // A pair may be the STOP_CODE, so with a checksum the bits of one have
+  // to follow it as well
+  uint32_t trailer = c->checksum ? CHECKSUM_BITS : 0;
+  while (!c->entropy && c->out_len < limit) {
+    uint8_t bit_len = bit_length(p.next_code);
+    uint32_t sym_len = c->lzw ? 0 : 8;
+    if (pair_bits_left(c) < (uint64_t)bit_len + sym_len + trailer) {
+      break;
+    }
+    // The whole pair is buffered, so reading it only fails at the STOP_CODE
+    bool more = c->lzw ? read_code(c, &curr_code, bit_len)
+                       : read_pair(c, &curr_code, &curr_sym, bit_len);
+    if (!more) {
+      result = DECODE_DONE;
+      break;
+    }
+    bool valid = c->lzw ? lzw_decode_code(c, &p, curr_code, &len)
+                        : decode_pair(c, curr_code, curr_sym, &p.next_code);
+    if (!valid) {
+      result = DECODE_CORRUPT;
+      break;
+    }
+  }
+  c->phrase = p;
+
+  // The checksum covers every symbol, so the buffer is written out first
+  if (result == DECODE_DONE && c->checksum) {
+    flush_words(c);
+    if (!read_checksum(c)) {
+      result = DECODE_CORRUPT;
+    }
+  }
+  return result;
+}
@@ -0,0 +1,362 @@
+#ifndef __CODEC_H__
+#define __CODEC_H__
+
+#include "bv.h"
+#include "code.h"
+#include "dict.h"
+#include "ring.h"
+#include "stats.h"
+#include "word.h"
+#include <inttypes.h>
+#include <stdbool.h>
+
+#define BLOCK 4096
+
+//
+// File descriptor that makes a Codec read its input from, or write its
+// output to, memory instead of a file.
+//
+#define MEM_FD -1
+
+//
+// Results of decompressing the pairs buffered in a Codec.
+//
+#define DECODE_MORE 0
+#define DECODE_DONE 1
+#define DECODE_CORRUPT -1
+
+//
+// Reset policies, what a Codec does once every code of its width is in use.
+// RESET_FULL empties the dictionary straight away. RESET_FREEZE stops adding
+// phrases and keeps matching the ones it has. RESET_ADAPTIVE freezes too, but
+// the encoder watches the bits per byte of every ADAPT_WINDOW symbols and
+// empties the dictionary once they rise more than a threshold percentage
+// above the best window since it filled up, or reach 8 bits per byte. That
+// reset is signalled in the stream by a pair with the largest code, which
+// no phrase of a full dictionary has, and its symbol starts the new
+// dictionary.
+//
+#define RESET_FULL 0
+#define RESET_FREEZE 1
+#define RESET_ADAPTIVE 2
+#define ADAPT_WINDOW (1 << 16)
+#define DEFAULT_THRESHOLD 10
+
+//
+// First code an LZW Codec assigns to a phrase. The dictionary of LZW starts
+// out with every single symbol, where the symbol sym has the code
+// START_CODE + sym, so only codes are written and no symbols.
+//
+#define LZW_START (START_CODE + 256)
+
+//
+// Largest number of pairs in a block of an entropy coded stream, and the
+// number of bytes the body of a block may take up.
+//
+#define BLOCK_PAIRS 8192
+#define BLOCK_BYTES (BLOCK_PAIRS * 6 + 256)
+
+//
+// Struct definition of a Phrase, the part of an input an encoder has matched
+// so far. It is kept between calls so that a phrase can span two of them.
+//
+// curr_code:   Code of the phrase matched so far.
+// prev_code:   Code of the phrase before the last symbol was matched. An LZW
+//              decoder keeps the code it read last here, STOP_CODE for none.
+// next_code:   Next code to assign to a new phrase.
+// prev_sym:    Last symbol matched.
+// len:         Number of symbols matched so far.
+// max_code:    Code at which the dictionary is full, set by the code width.
+//
+typedef struct Phrase {
+  uint32_t curr_code;
+  uint32_t prev_code;
+  uint32_t next_code;
+  uint8_t prev_sym;
+  uint32_t len;
+  uint32_t max_code;
+} Phrase;
+
+//
+// Struct definition of a Monitor, how well the full dictionary of an encoder
+// with the RESET_ADAPTIVE policy still compresses.
+//
+// syms:        Number of symbols of the current window.
+// bits:        Number of pair bits of the current window.
+// best:        Fewest bits per byte of a window since the dictionary filled up,
+//              zero before the first window.
+//
+typedef struct Monitor {
+  uint64_t syms;
+  uint64_t bits;
+  double best;
+} Monitor;
+
+//
+// Struct definition of a Codec, the state of a single compression or
+// decompression. Nothing is shared between two Codecs, so any number of
+// them can run at once, each on its own thread.
+//
+// width:       Number of bits of the largest code.
+// policy:      Reset policy once the dictionary is full.
+// threshold:   Percentage the bits per byte may rise by before RESET_ADAPTIVE
+//              resets the dictionary.
+// lzw:         True for LZW, where only codes are written, false for LZ78.
+// entropy:     True if pairs are gathered into blocks that are entropy coded.
+// checksum:    True if a CRC32C of the uncompressed bytes follows the stream.
+// infile:      File descriptor of the input file to read from.
+// outfile:     File descriptor of the output file to write to.
+// buffer:      Buffer to hold symbols.
+// byte_count:  Index of the current symbol in the buffer.
+// rbytes:      Number of bytes read into the buffer or the bit buffer.
+// bitbuf:      Buffer to hold the bits of pairs.
+// bit_index:   Index of the current bit in the bit buffer.
+// bit_acc:     Accumulator of bits between the pairs and the bit buffer.
+// acc_bits:    Number of bits in the accumulator.
+// total_syms:  Number of symbols read (compression) or written (decompression).
+// total_bits:  Number of bits written (compression) or read (decompression).
+// resets:      Number of times the dictionary or WordTable filled up.
+// dict:        Dictionary of an encoder, NULL for a decoder.
+// wt:          WordTable of a decoder, NULL for an encoder.
+// in_mem:      Input bytes when infile is MEM_FD.
+// in_len:      Number of input bytes in in_mem.
+// in_pos:      Number of input bytes read from in_mem.
+// out_mem:     Output bytes when outfile is MEM_FD, grown as needed.
+// out_len:     Number of output bytes written to out_mem.
+// out_cap:     Number of bytes allocated for out_mem.
+// in_ring:     Ring a thread reads infile ahead into, NULL to read it directly.
+// out_ring:    Ring a thread writes outfile from, NULL to write it directly.
+// phrase:      Phrase an encoder has matched so far.
+// monitor:     Monitor of a full dictionary for RESET_ADAPTIVE.
+// block_codes: Codes of the pairs of the current block of an entropy coded
+//              stream.
+// block_syms:  Symbols of the pairs of the block, apart from the codes.
+// block_len:   Number of pairs in the block.
+// block_pos:   Number of pairs of the block a decoder has decompressed.
+// block_buf:   Body of the block a decoder has read.
+// crc:         CRC32C of the symbols read (compression) or written
+//              (decompression) so far, kept when checksum is set.
+// shared:      Shared dictionary the first dictionary or WordTable of each
+//              input is primed with, NULL for none. Owned by the caller.
+// shared_len:  Number of bytes of the shared dictionary.
+// shared_id:   CRC32C of the shared dictionary, which identifies it.
+// prime_codes: Codes of the phrases that the primed phrases extend, in the
+//              order the primed phrases take their codes.
+// prime_syms:  Symbols the primed phrases extend them with.
+// nprimes:     Number of primed phrases.
+// prime_hist:  Length of the history of the WordTable once it is primed.
+// stats:       CodecStats to measure into, NULL to not measure. Owned by the
+//              caller, which sets it after creating the Codec.
+//
+typedef struct Codec {
+  uint8_t width;
+  uint8_t policy;
+  uint8_t threshold;
+  bool lzw;
+  bool entropy;
+  bool checksum;
+  int infile;
+  int outfile;
+  uint8_t buffer[BLOCK];
+  uint32_t byte_count;
+  uint32_t rbytes;
+  BitVector *bitbuf;
+  uint32_t bit_index;
+  uint64_t bit_acc;
+  uint32_t acc_bits;
+  uint64_t total_syms;
+  uint64_t total_bits;
+  uint64_t resets;
+  Dict *dict;
+  WordTable *wt;
+  const uint8_t *in_mem;
+  uint64_t in_len;
+  uint64_t in_pos;
+  uint8_t *out_mem;
+  uint64_t out_len;
+  uint64_t out_cap;
+  Ring *in_ring;
+  Ring *out_ring;
+  Phrase phrase;
+  Monitor monitor;
+  uint32_t *block_codes;
+  uint8_t *block_syms;
+  uint32_t block_len;
+  uint32_t block_pos;
+  uint8_t *block_buf;
+  uint32_t crc;
+  const uint8_t *shared;
+  uint32_t shared_len;
+  uint32_t shared_id;
+  uint32_t *prime_codes;
+  uint8_t *prime_syms;
+  uint32_t nprimes;
+  uint64_t prime_hist;
+  CodecStats *stats;
+} Codec;
+
+//
+// Constructor for a Codec that compresses.
+//
+// infile:  File descriptor of the uncompressed input.
+// outfile: File descriptor of the compressed output.
+// returns: Pointer to a Codec that has been allocated memory.
+//
+Codec *encoder_create(int infile, int outfile);
+
+//
+// Constructor for a Codec that decompresses.
+//
+// infile:  File descriptor of the compressed input.
+// outfile: File descriptor of the uncompressed output.
+// returns: Pointer to a Codec that has been allocated memory.
+//
+Codec *decoder_create(int infile, int outfile);
+
+//
+// Sets the number of bits of the largest code of a Codec, which is
+// DEFAULT_WIDTH for a new Codec. The dictionary or WordTable is replaced by
+// one of the new width, so this is only done before processing an input.
+//
+// c:       Codec to set the code width of.
+// width:   Number of bits, from MIN_WIDTH to MAX_WIDTH.
+// returns: Void.
+//
+void codec_set_width(Codec *c, uint8_t width);
+
+//
+// Sets the reset policy of a Codec, which is RESET_FULL for a new Codec.
+// A decoder has to use the policy its input was compressed with.
+//
+// c:         Codec to set the reset policy of.
+// policy:    One of RESET_FULL, RESET_FREEZE or RESET_ADAPTIVE.
+// threshold: Percentage for RESET_ADAPTIVE, only used by an encoder.
+// returns:   Void.
+//
+void codec_set_policy(Codec *c, uint8_t policy, uint8_t threshold);
+
+//
+// Switches a Codec between LZ78, the default, and LZW. The dictionary or
+// WordTable is emptied, and seeded with every single symbol for LZW, so
+// this is only done before processing an input.
+//
+// c:       Codec to set the mode of.
+// lzw:     True for LZW, false for LZ78.
+// returns: Void.
+//
+void codec_set_lzw(Codec *c, bool lzw);
+
+//
+// Switches the entropy coding of the pairs of a Codec on or off, which is
+// off for a new Codec. With it on, pairs are gathered into blocks of up to
+// BLOCK_PAIRS pairs, and each block is written with whichever of raw codes
+// and symbols or Huffman codes of them takes fewer bits.
+//
+// c:       Codec to set the entropy coding of.
+// entropy: True to entropy code the pairs, false to pack them as they are.
+// returns: Void.
+//
+void codec_set_entropy(Codec *c, bool entropy);
+
+//
+// Switches the checksum of a Codec on or off, which is off for a new Codec.
+// With it on, an encoder adds a CRC32C of its input after the end of the
+// stream, and a decoder checks the CRC32C of its output against it.
+//
+// c:         Codec to set the checksum of.
+// checksum:  True to write or check a checksum, false for none.
+// returns:   Void.
+//
+void codec_set_checksum(Codec *c, bool checksum);
+
+//
+// Sets the shared dictionary of a Codec, which is none for a new Codec.
+// The dictionary is parsed into phrases over and over, each pass adding
+// longer ones, until a quarter of the codes of the width are taken. The
+// dictionary or WordTable is primed with those phrases for every input, so
+// this is only done after the width and mode are set and before processing
+// an input. A reset within an input starts over from empty as before.
+//
+// c:       Codec to set the shared dictionary of.
+// shared:  Bytes of the shared dictionary, NULL for none. Not copied.
+// len:     Number of bytes of the shared dictionary.
+// returns: Void.
+//
+void codec_set_shared(Codec *c, const uint8_t *shared, uint32_t len);
+
+//
+// Destructor for a Codec.
+// The file descriptors of the Codec are not closed.
+//
+// c:       Codec to free allocated memory for.
+// returns: Void.
+//
+void codec_delete(Codec *c);
+
+//
+// Resets a Codec so that it can process another input from the start.
+// Buffers, counters and the dictionary or WordTable are emptied.
+// Memory input and output are rewound but not freed.
+//
+// c:       Codec to reset.
+// returns: Void.
+//
+void codec_reset(Codec *c);
+
+//
+// Compresses an array of symbols with a Codec.
+// Pairs are written to the output file as phrases end, but the phrase the
+// last symbols belong to is kept so that the next call can extend it.
+//
+// c:       Codec that compresses.
+// syms:    Array of symbols to compress.
+// len:     Number of symbols in the array.
+// returns: Void.
+//
+void codec_encode_syms(Codec *c, const uint8_t *syms, uint64_t len);
+
+//
+// Finishes a compression by writing out the pair of the last phrase, the
+// STOP_CODE, the checksum if any and any bits left in the buffer.
+//
+// c:       Codec that compresses.
+// returns: Void.
+//
+void codec_encode_finish(Codec *c);
+
+//
+// Compresses everything left in the input file of a Codec.
+// Pairs are written to the output file up to and including the STOP_CODE.
+// If the infile is MEM_FD, the memory input is compressed in place.
+// The FileHeader is not written.
+//
+// c:       Codec that compresses.
+// returns: Void.
+//
+void codec_encode(Codec *c);
+
+//
+// Decompresses the pairs in the input file of a Codec up to the STOP_CODE,
+// and checks the checksum after it if any.
+// The FileHeader must already have been read.
+//
+// c:       Codec that decompresses.
+// returns: Void.
+//
+void codec_decode(Codec *c);
+
+//
+// Decompresses as many pairs of the memory input of a Codec as have all of
+// their bits in it. The word table and next code are kept in the Codec, so
+// the next call carries on where this one stopped once more input is added.
+// Decompression also stops once limit bytes of output are in out_mem.
+//
+// c:       Codec that decompresses from memory.
+// limit:   Number of bytes in out_mem at which to stop.
+// returns: DECODE_DONE once the STOP_CODE is read, DECODE_CORRUPT if a
+//          pair refers to a code that doesn't exist yet or the checksum
+//          doesn't match, else DECODE_MORE.
+//
+int codec_decode_syms(Codec *c, uint64_t limit);
+
+#endif
@@ -0,0 +1,217 @@
+#include "crc.h"
+#include <pthread.h>
+#include <string.h>
+
+#if defined(__x86_64__)
+#include <nmmintrin.h>
+#elif defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#endif
+
+//
+// Polynomial of CRC32C, bit reversed as bytes are added from the LSB.
+//
+#define CRC32C_POLY 0x82F63B78
+
+//
+// Tables of slicing-by-8: crc_table[k][b] is the CRC of the byte b followed
+// by k zero bytes, so the 8 lookups of 8 bytes can be done at once.
+//
+static uint32_t crc_table[8][256];
+
+//
+// Function that adds bytes to a CRC, picked once for the CPU by crc_init().
+//
+static uint32_t (*crc_update)(uint32_t, const uint8_t *, uint64_t);
+static pthread_once_t crc_once = PTHREAD_ONCE_INIT;
+
+//
+// Adds bytes to a CRC with the tables of slicing-by-8, for CPUs with no CRC
+// instructions. The CRC is kept inverted, as the instructions keep it.
+//
+// crc:     Inverted CRC of the bytes before these.
+// buf:     Bytes to add.
+// len:     Number of bytes to add.
+// returns: Inverted CRC of the bytes before and these bytes.
+//
+static uint32_t crc_slice8(uint32_t crc, const uint8_t *buf, uint64_t len) {
+  // Bytes are put together in little endian order whatever the CPU uses,
+  // which compiles to plain loads on little endian CPUs
+  while (len >= 8) {
+    uint32_t lo = crc ^ (buf[0] | buf[1] << 8 | buf[2] << 16
+                         | (uint32_t)buf[3] << 24);
+    uint32_t hi = buf[4] | buf[5] << 8 | buf[6] << 16 | (uint32_t)buf[7] << 24;
+    crc = crc_table[7][lo & 0xFF] ^ crc_table[6][(lo >> 8) & 0xFF]
+          ^ crc_table[5][(lo >> 16) & 0xFF] ^ crc_table[4][lo >> 24]
+          ^ crc_table[3][hi & 0xFF] ^ crc_table[2][(hi >> 8) & 0xFF]
+          ^ crc_table[1][(hi >> 16) & 0xFF] ^ crc_table[0][hi >> 24];
+    buf += 8;
+    len -= 8;
+  }
+  while (len--) {
+    crc = crc_table[0][(crc ^ *buf++) & 0xFF] ^ (crc >> 8);
+  }
+  return crc;
+}
+
+#if defined(__x86_64__)
+//
+// Adds 8 bytes, or a single byte, to a CRC with the CRC32 instruction of
+// SSE4.2. Only called once the CPU is known to have it.
+//
+#define CRC_HW
+#define CRC_TARGET __attribute__((target("sse4.2")))
+CRC_TARGET static inline uint32_t crc_word(uint32_t crc, uint64_t word) {
+  return _mm_crc32_u64(crc, word);
+}
+CRC_TARGET static inline uint32_t crc_byte(uint32_t crc, uint8_t byte) {
+  return _mm_crc32_u8(crc, byte);
+}
+#elif defined(__ARM_FEATURE_CRC32)
+//
+// Adds 8 bytes, or a single byte, to a CRC with the CRC32C instructions of
+// ARMv8. The compiler only defines __ARM_FEATURE_CRC32 for CPUs that have
+// them.
+//
+#define CRC_HW
+#define CRC_TARGET
+static inline uint32_t crc_word(uint32_t crc, uint64_t word) {
+  return __crc32cd(crc, word);
+}
+static inline uint32_t crc_byte(uint32_t crc, uint8_t byte) {
+  return __crc32cb(crc, byte);
+}
+#endif
+
+#ifdef CRC_HW
+//
+// Number of bytes of each of the three lanes a CRC instruction runs on at
+// once, and the table that carries a CRC over that many zero bytes, so the
+// CRCs of the lanes can be put together. A BLOCK of symbols takes two sets
+// of lanes, with 16 bytes left over.
+//
+#define CRC_LANE 680
+static uint32_t crc_lane_table[4][256];
+
+//
+// Carries a CRC over CRC_LANE zero bytes, which is what becomes of it when
+// the lane after it is added.
+//
+// crc:     Inverted CRC to carry.
+// returns: Inverted CRC after CRC_LANE zero bytes.
+//
+static inline uint32_t crc_lane_shift(uint32_t crc) {
+  return crc_lane_table[0][crc & 0xFF] ^ crc_lane_table[1][(crc >> 8) & 0xFF]
+         ^ crc_lane_table[2][(crc >> 16) & 0xFF]
+         ^ crc_lane_table[3][crc >> 24];
+}
+
+//
+// Adds bytes to a CRC with the CRC instructions of the CPU. An instruction
+// has to wait for the one before it, so three lanes of bytes are run at
+// once and their CRCs put together after.
+//
+// crc:     Inverted CRC of the bytes before these.
+// buf:     Bytes to add.
+// len:     Number of bytes to add.
+// returns: Inverted CRC of the bytes before and these bytes.
+//
+CRC_TARGET static uint32_t crc_hw(uint32_t crc, const uint8_t *buf,
+    uint64_t len) {
+  while (len >= 3 * CRC_LANE) {
+    uint32_t a = crc;
+    uint32_t b = 0;
+    uint32_t c = 0;
+    for (uint32_t i = 0; i < CRC_LANE; i += 8) {
+      uint64_t words[3];
+      memcpy(&words[0], buf + i, sizeof(uint64_t));
+      memcpy(&words[1], buf + CRC_LANE + i, sizeof(uint64_t));
+      memcpy(&words[2], buf + 2 * CRC_LANE + i, sizeof(uint64_t));
+      a = crc_word(a, words[0]);
+      b = crc_word(b, words[1]);
+      c = crc_word(c, words[2]);
+    }
+    crc = crc_lane_shift(crc_lane_shift(a) ^ b) ^ c;
+    buf += 3 * CRC_LANE;
+    len -= 3 * CRC_LANE;
+  }
+  while (len >= 8) {
+    uint64_t word = 0;
+    memcpy(&word, buf, sizeof(word));
+    crc = crc_word(crc, word);
+    buf += 8;
+    len -= 8;
+  }
+  while (len--) {
+    crc = crc_byte(crc, *buf++);
+  }
+  return crc;
+}
+#endif
+
+//
+// Builds the tables of slicing-by-8 and picks the fastest way the CPU has to
+// add bytes to a CRC. Run once, by whichever thread first adds bytes.
+//
+// returns: Void.
+//
+static void crc_init(void) {
+  for (uint32_t b = 0; b < 256; b++) {
+    uint32_t crc = b;
+    for (int i = 0; i < 8; i++) {
+      crc = crc & 1 ? (crc >> 1) ^ CRC32C_POLY : crc >> 1;
+    }
+    crc_table[0][b] = crc;
+  }
+  for (uint32_t b = 0; b < 256; b++) {
+    for (int k = 1; k < 8; k++) {
+      uint32_t prev = crc_table[k - 1][b];
+      crc_table[k][b] = (prev >> 8) ^ crc_table[0][prev & 0xFF];
+    }
+  }
+
+  crc_update = crc_slice8;
+#ifdef CRC_HW
+  // A CRC is carried over zero bytes the same for each of its bits, so the
+  // bits are carried with the tables and then every byte is put together
+  uint32_t bits[32];
+  uint8_t zeros[CRC_LANE] = { 0 };
+  for (int i = 0; i < 32; i++) {
+    bits[i] = crc_slice8(1u << i, zeros, CRC_LANE);
+  }
+  for (int k = 0; k < 4; k++) {
+    for (uint32_t b = 0; b < 256; b++) {
+      uint32_t crc = 0;
+      for (int i = 0; i < 8; i++) {
+        crc ^= b >> i & 1 ? bits[8 * k + i] : 0;
+      }
+      crc_lane_table[k][b] = crc;
+    }
+  }
+#if defined(__x86_64__)
+  if (__builtin_cpu_supports("sse4.2")) {
+    crc_update = crc_hw;
+  }
+#else
+  crc_update = crc_hw;
+#endif
+#endif
+  return;
+}
+
+//
+// Adds bytes to a CRC32C, the Castagnoli CRC of iSCSI and ext4. The CRC of
+// no bytes is zero, and the CRC of some bytes is carried on over more bytes
+// by passing it back in, so a stream can be checksummed a block at a time.
+// The CRC instructions of SSE4.2 or ARMv8 are used where the CPU has them,
+// otherwise eight tables are looked up for every 8 bytes.
+//
+// crc:     CRC of the bytes before these, zero to start a new CRC.
+// buf:     Bytes to add.
+// len:     Number of bytes to add.
+// returns: CRC of the bytes before and these bytes.
+//
+uint32_t crc32c(uint32_t crc, const uint8_t *buf, uint64_t len) {
+  pthread_once(&crc_once, crc_init);
+  return ~crc_update(~crc, buf, len);
+}
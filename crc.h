@@ -0,0 +1,20 @@
+#ifndef __CRC_H__
+#define __CRC_H__
+
+#include <inttypes.h>
+
+//
+// Adds bytes to a CRC32C, the Castagnoli CRC of iSCSI and ext4. The CRC of
+// no bytes is zero, and the CRC of some bytes is carried on over more bytes
+// by passing it back in, so a stream can be checksummed a block at a time.
+// The CRC instructions of SSE4.2 or ARMv8 are used where the CPU has them,
+// otherwise eight tables are looked up for every 8 bytes.
+//
+// crc:     CRC of the bytes before these, zero to start a new CRC.
+// buf:     Bytes to add.
+// len:     Number of bytes to add.
+// returns: CRC of the bytes before and these bytes.
+//
+uint32_t crc32c(uint32_t crc, const uint8_t *buf, uint64_t len);
+
+#endif
@@ -1,36 +1,49 @@
-#include "bv.h"
-#include "code.h"
+#include "codec.h"
+#include "frame.h"
 #include "io.h"
-#include "word.h"
+#include "shared.h"
+#include <ctype.h>
+#include <errno.h>
 #include <fcntl.h>
+#include <getopt.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 
 // Defined option for the command line arguements
-#define OPTIONS "vi:o:"
+#define OPTIONS "vi:o:t:m:T:R:D:P"
 
-// Global variables to count bytes
-// // for compression and decompression
-uint64_t total_syms = 0;
-uint64_t total_bits = 0;
+// Long names of options, --range is the same as -R
+static struct option long_options[] = {
+  { "range", required_argument, NULL, 'R' },
+  { NULL, 0, NULL, 0 },
+};
 
 // Bool flags for getopt arguments
 bool Stats = false;
 bool user_infile = false;
 bool user_outfile = false;
 
-// Global Bitbuffer to be accessed in io.c
-BitVector *bitbuf;
+// Path of the file to write metrics to, NULL to not write any
+char *metrics_file = NULL;
 
-//
-// This function simply identifies the minimum number
-// of bits needed for the code being passsed in
-//
-// uint16_t nex_code:           16 bit code integer
-//
-uint8_t bit_length(uint16_t next_code);
+// Number of phrases between two trace samples, 0 to not trace
+uint64_t trace_every = 0;
+
+// Number of threads that decompress frames
+int threads = 0;
+
+// Range of the uncompressed bytes to decompress from an indexed stream
+bool user_range = false;
+uint64_t range_start = 0;
+uint64_t range_len = 0;
+
+// Path of the shared dictionary the infile was compressed with, NULL for none
+char *shared_path = NULL;
+
+// Read the infile ahead and write the outfile behind on threads of their own
+bool pipelined = false;
 
 //
 // This function parses through the command line arguments
@@ -71,53 +84,142 @@ int main(int argc, char **argv) {
     infile = STDIN_FILENO;
   }
 
+  // The outfile is STDOUT until the header says what the infile holds
+  outfile = STDOUT_FILENO;
+
+  // Create the decoder that owns the buffers, counters and word table
+  Codec *c = decoder_create(infile, outfile);
+
+  // Measure the phases of the decompression if stats are printed
+  Clock start, total = { 0, 0 };
+  if (Stats || metrics_file || trace_every) {
+    c->stats = stats_create();
+    clock_now(&start);
+  }
+  if (trace_every) {
+    stats_trace_start(c->stats, stderr, trace_every, false);
+  }
+
+  // Read the infile ahead on a thread of its own, unless a range is to be
+  // decoded, which seeks to its frames
+  if (pipelined && !user_range) {
+    pipe_infile(c);
+  }
+
+  // Read header file from infile, the members of an archive are extracted
+  // below the directory given as the outfile
+  read_header(c, header);
+  bool archive = header->magic == ARCHIVE_MAGIC
+                 || header->magic == LZW_ARCHIVE_MAGIC;
+
   // Set the outfile to the read in file from command line arguments
-  // or set it to STDOUT by default
-  if (user_outfile) {
-    outfile = open(write_file, O_WRONLY | O_CREAT | O_TRUNC);
-  } else {
-    outfile = STDOUT_FILENO;
-  }
-
-  // Read header file from infile and copy protection number
-  // to outfile
-  read_header(infile, header);
-  fchmod(outfile, header->protection);
-
-  WordTable *wt;
-
-  // Check if the magic number read in from the file is the same
-  // as the MAGIC number macro else exit
-  if (header->magic == MAGIC) {
-    // Create Read buffer with 4096 elements
-    bitbuf = bv_create(BLOCK * 8);
-
-    wt = wt_create();
-    uint8_t curr_sym = 0;
-    uint16_t curr_code = 0;
-    uint16_t next_code = START_CODE;
-
-    // Loop until there are no more bits to procress in the read buffer
-    while (read_pair(infile, &curr_code, &curr_sym, bit_length(next_code))) {
-      // Puts a new word or an appended word into the wordtable
-      wt[next_code] = word_append_sym(wt[curr_code], curr_sym);
-      // Buffer the word into the symbol buffer
-      buffer_word(outfile, wt[next_code]);
-      next_code++;
-      // If code reaches its max value reset the word table and next_code
-      if (next_code == MAX_CODE) {
-        wt_reset(wt);
-        next_code = START_CODE;
-      }
+  // or leave it as STDOUT, and copy the protection number to it
+  if (!archive) {
+    if (user_outfile) {
+      outfile = open(write_file, O_WRONLY | O_CREAT | O_TRUNC);
+      c->outfile = outfile;
+    }
+    fchmod(outfile, header->protection);
+    if (pipelined) {
+      pipe_outfile(c);
     }
-    // Flush any remaining symbols from the buffer into the oufile
-    flush_words(outfile);
+  }
+
+  // Use the code width the infile was compressed with, streams that don't
+  // give one use the default
+  uint8_t width = header->width ? header->width : DEFAULT_WIDTH;
+  if (width < MIN_WIDTH || width > MAX_WIDTH) {
+    printf("The encoded file has an invalid code width!\n");
+    codec_delete(c);
+    free(header);
+    exit(EXIT_FAILURE);
+  }
+  codec_set_width(c, width);
+
+  // Follow the reset policy of the encoder, resets it decided on are
+  // signalled in the stream, and the flags it wrote the stream with
+  uint8_t policy = header->policy & POLICY_MASK;
+  if (policy > RESET_ADAPTIVE
+      || (header->policy & ~POLICY_MASK & ~FLAG_ENTROPY & ~FLAG_CHECKSUM
+          & ~FLAG_INDEX & ~FLAG_SHARED)) {
+    printf("The encoded file has an invalid reset policy!\n");
+    codec_delete(c);
+    free(header);
+    exit(EXIT_FAILURE);
+  }
+  codec_set_policy(c, policy, DEFAULT_THRESHOLD);
+
+  // Check if the magic number read in from the file is one of the MAGIC
+  // number macros else exit, the LZW ones seed the dictionary first
+  bool lzw = header->magic == LZW_MAGIC || header->magic == LZW_FRAME_MAGIC
+             || header->magic == LZW_ARCHIVE_MAGIC;
+  codec_set_lzw(c, lzw);
+  codec_set_entropy(c, header->policy & FLAG_ENTROPY);
+  codec_set_checksum(c, header->policy & FLAG_CHECKSUM);
+
+  // Prime the word table with the shared dictionary the infile was
+  // compressed with, which has to be the one given by its ID
+  uint8_t *shared = NULL;
+  if (header->policy & FLAG_SHARED) {
+    uint32_t shared_id = c->shared_id;
+    uint32_t shared_len = 0;
+    if (!shared_path) {
+      printf("The encoded file needs the shared dictionary %08x!\n",
+          shared_id);
+      codec_delete(c);
+      free(header);
+      exit(EXIT_FAILURE);
+    }
+    shared = shared_load(shared_path, &shared_len);
+    codec_set_shared(c, shared, shared_len);
+    if (c->shared_id != shared_id) {
+      printf("The encoded file needs the shared dictionary %08x, not %08x!\n",
+          shared_id, c->shared_id);
+      codec_delete(c);
+      free(shared);
+      free(header);
+      exit(EXIT_FAILURE);
+    }
+  }
+  bool framed = header->magic == FRAME_MAGIC
+                || header->magic == LZW_FRAME_MAGIC;
+  if (user_range) {
+    // Only the frames of the range are read, which takes the index
+    if (!framed || !(header->policy & FLAG_INDEX)) {
+      printf("The encoded file has no index to decode a range from!\n");
+      codec_delete(c);
+      free(header);
+      exit(EXIT_FAILURE);
+    }
+    frame_decode_range(c, range_start, range_len);
+  } else if (header->magic == MAGIC || header->magic == LZW_MAGIC) {
+    // Decompress the infile into the outfile
+    codec_decode(c);
+  } else if (framed) {
+    // Decompress the frames of the infile with a pool of threads
+    if (threads <= 0) {
+      threads = sysconf(_SC_NPROCESSORS_ONLN);
+    }
+    frame_decode(c, threads);
+  } else if (archive) {
+    // Decompress the members of the infile with a pool of threads
+    if (threads <= 0) {
+      threads = sysconf(_SC_NPROCESSORS_ONLN);
+    }
+    batch_decode(c, threads, user_outfile ? write_file : NULL);
   } else {
     printf("The encoded file can not be decoded with this program!\n");
+    codec_delete(c);
     free(header);
     exit(EXIT_FAILURE);
   }
 
+  // Write out what the outfile thread still has before the outfile closes
+  unpipe_files(c);
+  if (c->stats) {
+    clock_add(&total, &start);
+  }
+
   // If the infile isnt STDIN close the file descriptor
   if (user_infile) {
     if (close(infile) < 0) {
@@ -126,7 +228,7 @@ int main(int argc, char **argv) {
     }
   }
   // If the outfile isnt STDOUT close the file descriptor
-  if (user_outfile) {
+  if (user_outfile && !archive) {
     if (close(outfile) < 0) {
       printf("Error: Failed to close outfile!\n");
       exit(EXIT_FAILURE);
@@ -135,46 +237,32 @@ int main(int argc, char **argv) {
 
   // Stats calculation and output if flag is set in command line arguements
   uint64_t compressed = 0;
-  if (total_bits % 8 == 0) {
-    compressed = total_bits / 8;
+  if (c->total_bits % 8 == 0) {
+    compressed = c->total_bits / 8;
   } else {
-    compressed = total_bits / 8 + 1;
+    compressed = c->total_bits / 8 + 1;
   }
   if (Stats) {
     printf("Compressed file size: %lu bytes\n", compressed);
-    printf("Uncompressed file size: %lu bytes\n", total_syms);
+    printf("Uncompressed file size: %lu bytes\n", c->total_syms);
     printf("Compressed ratio: %.2lf%%\n",
-        100 * (1 - (compressed / 1.00) / total_syms));
+        100 * (1 - (compressed / 1.00) / c->total_syms));
+    stats_print(c->stats, &total, c->total_syms, c->resets);
+  }
+  if (metrics_file) {
+    stats_export(c, metrics_file, false, &total);
+  }
+  if (c->stats) {
+    stats_delete(c->stats);
   }
 
-  // Deallocate memory from Word ADT, bit buffer, and File Header
-  bv_delete(bitbuf);
-  wt_delete(wt);
+  // Deallocate memory from the decoder, shared dictionary and File Header
+  codec_delete(c);
+  free(shared);
   free(header);
   return 0;
 }
 
-//
-// This function simply identifies the minimum number
-// of bits needed for the code being passsed in
-//
-// uint16_t nex_code:           16 bit code integer
-//
-uint8_t bit_length(uint16_t next_code) {
-  uint8_t zeros = 0;
-  uint8_t bits = 0;
-  // Loop through all the bits in the code
-  for (int i = 0; i < 16; i++) {
-    zeros++;
-    // Check if each is on
-    if (next_code & (1 << i)) {
-      // Add the place of the bit
-      bits = zeros;
-    }
-  }
-  return bits;
-}
-
 //
 // This function parses through the command line arguments
 // and sets the appropriate flags for the program
@@ -187,7 +275,7 @@ uint8_t bit_length(uint16_t next_code) {
 void get_options(int argc, char **argv, char **read_file, char **write_file) {
   int c = 0;
   // Loop until all command line arguements are read
-  while ((c = getopt(argc, argv, OPTIONS)) != -1) {
+  while ((c = getopt_long(argc, argv, OPTIONS, long_options, NULL)) != -1) {
     // Condition for the Stats flag
     if (c == 'v') {
       // Set the Stats bool to true
@@ -204,6 +292,45 @@ void get_options(int argc, char **argv, char **read_file, char **write_file) {
       user_outfile = true;
       // Get the name of the text file and assign it to write_file
       (*write_file) = optarg;
+      // The threads flag
+    } else if (c == 't') {
+      threads = atoi(optarg);
+      // The metrics file flag
+    } else if (c == 'm') {
+      metrics_file = optarg;
+      // The trace flag, followed by the number of phrases between samples
+    } else if (c == 'T') {
+      trace_every = strtoull(optarg, NULL, 10);
+      if (trace_every == 0) {
+        printf("Error: Trace must sample at least every phrase!\n");
+        exit(EXIT_FAILURE);
+      }
+      // The range flag, given as the offset and length of the range
+    } else if (c == 'R') {
+      // Both numbers must be there and be unsigned, strtoull() would take
+      // a missing one as 0 and wrap a negative one around
+      char *end = optarg;
+      errno = 0;
+      if (isdigit((unsigned char)*end)) {
+        range_start = strtoull(end, &end, 10);
+      }
+      if (end == optarg || *end != ':' || !isdigit((unsigned char)end[1])) {
+        printf("Error: Range must be given as start:len!\n");
+        exit(EXIT_FAILURE);
+      }
+      range_len = strtoull(end + 1, &end, 10);
+      if (*end != '\0' || errno == ERANGE
+          || range_start + range_len < range_start) {
+        printf("Error: Range must be given as start:len!\n");
+        exit(EXIT_FAILURE);
+      }
+      user_range = true;
+      // The shared dictionary flag, followed by the path of the dictionary
+    } else if (c == 'D') {
+      shared_path = optarg;
+      // The pipelined flag
+    } else if (c == 'P') {
+      pipelined = true;
     }
   }
 }
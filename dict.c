@@ -0,0 +1,151 @@
+#include "dict.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+//
+// Hashes a (prefix code, symbol) key into a slot index of the table.
+// Multiplicative hashing spreads the sequential codes over the whole table.
+//
+// d:       Dict the table belongs to.
+// key:     Key to hash.
+// returns: Index of the first slot to probe.
+//
+static inline uint32_t dict_hash(Dict *d, uint32_t key) {
+  return (key * 2654435761u) >> (32 - d->bits);
+}
+
+//
+// Constructor for a Dict.
+// The Dict starts out empty, which is the same as a Trie with only a root.
+// The root is the phrase with the code EMPTY_CODE.
+//
+// width:   Number of bits of the largest code the Dict holds.
+// returns: Pointer to a Dict that has been allocated memory.
+//
+Dict *dict_create(uint8_t width) {
+  Dict *d = (Dict *)calloc(1, sizeof(Dict));
+  if (!d) {
+    printf("Error: Failed to allocate memory for Dict!\n");
+    exit(EXIT_FAILURE);
+  }
+
+  // Allocate the slots, a code of zero (STOP_CODE) marks an empty slot
+  d->bits = width + 1;
+  d->mask = (1u << d->bits) - 1;
+  d->table = (DictEntry *)calloc(d->mask + 1, sizeof(DictEntry));
+
+  // The slots taken are logged for up to a quarter of the table, enough
+  // for a primed Dict to have its slots rewound to the primed phrases
+  d->ncap = (d->mask + 1) / 4;
+  d->used = (uint32_t *)malloc(d->ncap * sizeof(uint32_t));
+  if (!d->table || !d->used) {
+    printf("Error: Failed to allocate memory for Dict table!\n");
+    exit(EXIT_FAILURE);
+  }
+  return d;
+}
+
+//
+// Resets a Dict to being empty.
+//
+// d:       Dict to reset.
+// returns: Void.
+//
+void dict_reset(Dict *d) {
+  // Only the slots of a small input are cleared, which is what keeps a
+  // Codec cheap to reuse for many small files, otherwise clearing the flat
+  // table is a single pass over contiguous memory. Past a sixteenth of the
+  // slots that pass clears it faster than clearing them one at a time
+  if (d->count <= (d->mask + 1) / 16) {
+    for (uint32_t i = 0; i < d->count; i++) {
+      d->table[d->used[i]].code = STOP_CODE;
+    }
+  } else {
+    memset(d->table, 0, (d->mask + 1) * sizeof(DictEntry));
+  }
+  d->count = 0;
+  return;
+}
+
+//
+// Takes the phrases stored in a Dict after its first count phrases back out,
+// as long as they are few enough to clear one at a time. Later phrases only
+// ever probe past earlier ones, so the first phrases are left as they were.
+//
+// d:       Dict to rewind.
+// count:   Number of phrases to keep.
+// returns: False if the Dict has to be reset instead, true otherwise.
+//
+bool dict_rewind(Dict *d, uint32_t count) {
+  if (d->count < count || d->count > d->ncap
+      || d->count - count > (d->mask + 1) / 16) {
+    return false;
+  }
+  for (uint32_t i = count; i < d->count; i++) {
+    d->table[d->used[i]].code = STOP_CODE;
+  }
+  d->count = count;
+  return true;
+}
+
+//
+// Destructor for a Dict.
+//
+// d:       Dict to free allocated memory for.
+// returns: Void.
+//
+void dict_delete(Dict *d) {
+  free(d->used);
+  free(d->table);
+  free(d);
+  return;
+}
+
+//
+// Returns the code of the phrase made from the phrase code followed by sym.
+// If the phrase doesn't exist, STOP_CODE is returned.
+//
+// d:       Dict to look in.
+// code:    Code of the phrase to step from.
+// sym:     Symbol to check for.
+// returns: Code of the extended phrase, or STOP_CODE if there is none.
+//
+uint32_t dict_step(Dict *d, uint32_t code, uint8_t sym) {
+  uint32_t key = (code << 8) | sym;
+  uint32_t slot = dict_hash(d, key);
+  // Probe until the key or an empty slot is found, the table is never full
+  while (d->table[slot].code != STOP_CODE) {
+    if (d->table[slot].key == key) {
+      return d->table[slot].code;
+    }
+    slot = (slot + 1) & d->mask;
+  }
+  return STOP_CODE;
+}
+
+//
+// Adds the phrase made from the phrase code followed by sym to a Dict.
+// The phrase must not already be in the Dict.
+//
+// d:         Dict to add to.
+// code:      Code of the phrase to extend.
+// sym:       Symbol to extend the phrase with.
+// next_code: Code to assign to the new phrase.
+// returns:   Void.
+//
+void dict_insert(Dict *d, uint32_t code, uint8_t sym, uint32_t next_code) {
+  uint32_t key = (code << 8) | sym;
+  uint32_t slot = dict_hash(d, key);
+  // Find the first empty slot along the probe sequence
+  while (d->table[slot].code != STOP_CODE) {
+    slot = (slot + 1) & d->mask;
+  }
+  d->table[slot].key = key;
+  d->table[slot].code = next_code;
+  if (d->count < d->ncap) {
+    d->used[d->count] = slot;
+  }
+  d->count++;
+  return;
+}
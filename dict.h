@@ -0,0 +1,105 @@
+#ifndef __DICT_H__
+#define __DICT_H__
+
+#include "code.h"
+#include <inttypes.h>
+#include <stdbool.h>
+
+//
+// Struct definition of a DictEntry.
+//
+// key:   The phrase the entry represents, stored as the code of its prefix
+//        shifted left by 8 bits with the appended symbol in the low 8 bits.
+// code:  Unique code for the phrase. STOP_CODE marks an empty slot.
+//
+typedef struct DictEntry {
+  uint32_t key;
+  uint32_t code;
+} DictEntry;
+
+//
+// Struct definition of a Dict, a flat open-addressing hash table that maps
+// (prefix code, symbol) pairs to codes. It replaces a Trie for the encoder.
+//
+// The number of slots is the number of codes of the width of the Dict
+// rounded up to a power of two and doubled, so that the table is never more
+// than half full.
+//
+// table: Array of entries, probed linearly.
+// count: Number of phrases currently stored in the table.
+// bits:  Number of bits of a slot index.
+// mask:  Number of slots minus one.
+// used:  Slots of the first phrases stored since the last reset, so that a
+//        table with few phrases can be cleared without a pass over it all.
+// ncap:  Number of slots the used array has room for.
+//
+typedef struct Dict {
+  DictEntry *table;
+  uint32_t count;
+  uint32_t bits;
+  uint32_t mask;
+  uint32_t *used;
+  uint32_t ncap;
+} Dict;
+
+//
+// Constructor for a Dict.
+// The Dict starts out empty, which is the same as a Trie with only a root.
+// The root is the phrase with the code EMPTY_CODE.
+//
+// width:   Number of bits of the largest code the Dict holds.
+// returns: Pointer to a Dict that has been allocated memory.
+//
+Dict *dict_create(uint8_t width);
+
+//
+// Resets a Dict to being empty.
+//
+// d:       Dict to reset.
+// returns: Void.
+//
+void dict_reset(Dict *d);
+
+//
+// Takes the phrases stored in a Dict after its first count phrases back out,
+// as long as they are few enough to clear one at a time. Later phrases only
+// ever probe past earlier ones, so the first phrases are left as they were.
+//
+// d:       Dict to rewind.
+// count:   Number of phrases to keep.
+// returns: False if the Dict has to be reset instead, true otherwise.
+//
+bool dict_rewind(Dict *d, uint32_t count);
+
+//
+// Destructor for a Dict.
+//
+// d:       Dict to free allocated memory for.
+// returns: Void.
+//
+void dict_delete(Dict *d);
+
+//
+// Returns the code of the phrase made from the phrase code followed by sym.
+// If the phrase doesn't exist, STOP_CODE is returned.
+//
+// d:       Dict to look in.
+// code:    Code of the phrase to step from.
+// sym:     Symbol to check for.
+// returns: Code of the extended phrase, or STOP_CODE if there is none.
+//
+uint32_t dict_step(Dict *d, uint32_t code, uint8_t sym);
+
+//
+// Adds the phrase made from the phrase code followed by sym to a Dict.
+// The phrase must not already be in the Dict.
+//
+// d:         Dict to add to.
+// code:      Code of the phrase to extend.
+// sym:       Symbol to extend the phrase with.
+// next_code: Code to assign to the new phrase.
+// returns:   Void.
+//
+void dict_insert(Dict *d, uint32_t code, uint8_t sym, uint32_t next_code);
+
+#endif
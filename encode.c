@@ -1,7 +1,8 @@
-#include "bv.h"
-#include "code.h"
+#include "codec.h"
+#include "frame.h"
 #include "io.h"
-#include "trie.h"
+#include "shared.h"
+#include <dirent.h>
 #include <fcntl.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -9,28 +10,57 @@
 #include <sys/types.h>
 
 // Defined option for the command line arguements
-#define OPTIONS "vi:o:"
-
-// Global variables to count bytes
-// for compression and decompression
-uint64_t total_syms;
-uint64_t total_bits;
+#define OPTIONS "vi:o:b:t:m:T:w:r:lecsB:D:X:P"
 
 // Bool flags for getopt arguments
 bool Stats = false;
 bool user_infile = false;
 bool user_outfile = false;
 
-// Global Bitbuffer to be accessed in io.c
-BitVector *bitbuf;
+// Path of the file to write metrics to, NULL to not write any
+char *metrics_file = NULL;
 
-//
-// This function simply identifies the minimum number
-// of bits needed for the code being passsed in
-//
-// uint16_t nex_code:		16 bit code integer
-//
-uint8_t bit_length(uint16_t next_code);
+// Number of phrases between two trace samples, 0 to not trace
+uint64_t trace_every = 0;
+
+// Framed format options: size of each frame and number of threads
+bool user_frames = false;
+uint32_t frame_size = FRAME_SIZE;
+int threads = 0;
+
+// Number of bits of the largest code
+uint8_t width = DEFAULT_WIDTH;
+
+// Reset policy once the dictionary is full, and the percentage the bits per
+// byte may rise by before the adaptive policy resets it
+uint8_t policy = RESET_FULL;
+uint8_t threshold = DEFAULT_THRESHOLD;
+
+// Write an LZW stream of codes only instead of LZ78 pairs
+bool lzw = false;
+
+// Entropy code blocks of pairs instead of packing them as they are
+bool entropy = false;
+
+// Add a CRC32C of the input after the end of the stream
+bool checksum = false;
+
+// Write an index of the frames so ranges can be decompressed on their own
+bool seekable = false;
+
+// Path of the directory or list of files to compress as a batch, NULL for
+// a single infile
+char *batch_path = NULL;
+
+// Path of the shared dictionary to prime the dictionary with, NULL for none
+char *shared_path = NULL;
+
+// Number of bytes of a dictionary to train from the batch instead of
+// compressing it, 0 to compress
+uint32_t train_size = 0;
+
+// Read the infile ahead and write the outfile behind on threads of their own
+bool pipelined = false;
 
 //
 // This function parses through the command line arguments
@@ -43,6 +73,18 @@ uint8_t bit_length(uint16_t next_code);
 //
 void get_options(int argc, char **argv, char **read_file, char **write_file);
 
+//
+// Gathers the paths of the files of a batch: every regular file in a
+// directory, in name order, or one path per line of a list of files, with
+// "-" being a list read from stdin. Files in a directory that already end
+// in BATCH_SUFFIX are left out.
+//
+// path:    Path of the directory or list.
+// n:       Pointer to store the number of paths into.
+// returns: Array of paths that has been allocated memory, as has each path.
+//
+char **batch_files(char *path, uint32_t *n);
+
 int main(int argc, char **argv) {
   // nitialize char pointers for files names
   char *read_file = NULL;
@@ -52,6 +94,26 @@ int main(int argc, char **argv) {
   // set the appropriate flags
   get_options(argc, argv, &read_file, &write_file);
 
+  // Train a shared dictionary from the files of the batch and write it out
+  // instead of compressing anything
+  if (train_size) {
+    uint32_t nfiles = 0;
+    uint32_t len = 0;
+    char **files = batch_files(batch_path, &nfiles);
+    uint8_t *dict = shared_train(files, nfiles, train_size, &len);
+    shared_save(shared_path, dict, len);
+    if (Stats) {
+      printf("Dictionary size: %u bytes\n", len);
+      printf("Samples: %u files\n", nfiles);
+    }
+    for (uint32_t i = 0; i < nfiles; i++) {
+      free(files[i]);
+    }
+    free(files);
+    free(dict);
+    return 0;
+  }
+
   // Allocate memory for a FileHeader member
   FileHeader *header = (FileHeader *)calloc(1, sizeof(FileHeader));
   if (!header) {
@@ -59,11 +121,22 @@ int main(int argc, char **argv) {
     exit(EXIT_FAILURE);
   }
 
-  // Initialize the magic number in the File Header
-  header->magic = MAGIC;
-
-  // Create a bit buffer will 4096 elements
-  bitbuf = bv_create(BLOCK * 8);
+  // Initialize the magic number in the File Header, which tells the
+  // decoder whether the stream is split into frames or members and whether
+  // it is LZW. The files of a batch written to an outfile are members, and
+  // the files of a batch written on their own are single streams whatever
+  // -t or -b say, since -t only sets the threads of the batch
+  bool archive = batch_path && user_outfile;
+  bool framed = user_frames && !batch_path;
+  if (lzw) {
+    header->magic = archive  ? LZW_ARCHIVE_MAGIC
+                    : framed ? LZW_FRAME_MAGIC
+                             : LZW_MAGIC;
+  } else {
+    header->magic = archive  ? ARCHIVE_MAGIC
+                    : framed ? FRAME_MAGIC
+                             : MAGIC;
+  }
 
   // In and outfile descriptors
   int infile = 0;
@@ -86,63 +159,96 @@ int main(int argc, char **argv) {
   }
 
   // Get the protection number from the infile and copy it over to the
-  // outfile
+  // outfile, an archive has no single infile so it gets the permissions
+  // of a new file
   struct stat srcstats;
-  fstat(infile, &srcstats);
+  if (batch_path) {
+    srcstats.st_mode = S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH;
+  } else {
+    fstat(infile, &srcstats);
+  }
   fchmod(outfile, srcstats.st_mode);
   header->protection = srcstats.st_mode;
+  header->width = width;
+  header->policy = policy | (entropy ? FLAG_ENTROPY : 0)
+                   | (checksum ? FLAG_CHECKSUM : 0)
+                   | (seekable ? FLAG_INDEX : 0)
+                   | (shared_path ? FLAG_SHARED : 0);
 
-  // write the haeader file into the outfile
-  write_header(outfile, header);
+  // Create the encoder that owns the buffers, counters and dictionary
+  Codec *c = encoder_create(infile, outfile);
+  codec_set_width(c, width);
+  codec_set_policy(c, policy, threshold);
+  codec_set_lzw(c, lzw);
+  codec_set_entropy(c, entropy);
+  codec_set_checksum(c, checksum);
+  uint32_t shared_len = 0;
+  uint8_t *shared = shared_path ? shared_load(shared_path, &shared_len) : NULL;
+  if (shared) {
+    codec_set_shared(c, shared, shared_len);
+  }
 
-  // Declare Tre root and helper pointers
-  TrieNode *root = trie_create();
-  TrieNode *curr_node = root;
-  TrieNode *prev_node = NULL;
+  // Measure the phases of the compression if stats are printed
+  Clock start, total = { 0, 0 };
+  if (Stats || metrics_file || trace_every) {
+    c->stats = stats_create();
+    clock_now(&start);
+  }
+  if (trace_every) {
+    stats_trace_start(c->stats, stderr, trace_every, true);
+  }
 
-  // Declare helper symbol variables
-  uint8_t curr_sym = 0;
-  uint8_t prev_sym = 0;
+  // Write the outfile behind on a thread of its own, and read the infile
+  // ahead on another, a batch reads its files whole and has no infile
+  if (pipelined && (!batch_path || archive)) {
+    pipe_outfile(c);
+  }
+  if (pipelined && !batch_path) {
+    pipe_infile(c);
+  }
 
-  // Setting the next_code to the start of the code (2)
-  uint16_t next_code = START_CODE;
+  if (threads <= 0) {
+    threads = sysconf(_SC_NPROCESSORS_ONLN);
+  }
+  if (batch_path) {
+    // Compress each file of the batch with a pool of threads, into a file
+    // of its own or into the archive in the outfile
+    uint32_t nfiles = 0;
+    char **files = batch_files(batch_path, &nfiles);
+    if (archive) {
+      write_header(c, header);
+    }
+    batch_encode(c, header, files, nfiles, threads, archive);
+    for (uint32_t i = 0; i < nfiles; i++) {
+      free(files[i]);
+    }
+    free(files);
+  } else {
+    // write the haeader file into the outfile
+    write_header(c, header);
 
-  // Loop until there is no symbols left to process
-  while (read_sym(infile, &curr_sym)) {
-    // Set the next_node to the child of the current node based on the current
-    // symbol as the index
-    TrieNode *next_node = trie_step(curr_node, curr_sym);
+    // Map a regular infile into memory so the compression loop can walk its
+    // bytes directly, anything else is read a block at a time, and a piped
+    // infile is read from its thread
+    bool mapped = !pipelined && map_infile(c);
 
-    // Check if that node exists
-    if (next_node != NULL) {
-      prev_node = curr_node;
-      curr_node = next_node;
+    // Compress the infile into the outfile, either as one stream or as
+    // frames compressed by a pool of threads
+    if (user_frames) {
+      frame_encode(c, frame_size, threads, seekable);
     } else {
-      // Buffer the current symbol into the write buffer with its corresponding
-      // code
-      buffer_pair(outfile, curr_node->code, curr_sym, bit_length(next_code));
-      curr_node->children[curr_sym] = trie_node_create(next_code);
-      curr_node = root;
-      next_code = next_code + 1;
+      codec_encode(c);
     }
-    // Check if the code is at the MAX of a uint16
-    if (next_code == MAX_CODE) {
-      // If so reset the Trie ADT and reset the node and code
-      trie_reset(root);
-      curr_node = root;
-      next_code = START_CODE;
+    if (mapped) {
+      unmap_infile(c);
     }
-    prev_sym = curr_sym;
-  }
-  if (curr_node != root) {
-    buffer_pair(outfile, prev_node->code, prev_sym, bit_length(next_code));
-    next_code = (next_code + 1) % MAX_CODE;
   }
 
-  // Put the STOP_CODE value with no symbol to signify the end of the buffer/file
-  buffer_pair(outfile, STOP_CODE, 0, bit_length(next_code));
-  // Flush any remaining bits from the buffer into the oufile
-  flush_pairs(outfile);
+  // Write out what the outfile thread still has before the outfile closes
+  unpipe_files(c);
+  if (c->stats) {
+    clock_add(&total, &start);
+  }
 
   // If the infile isnt STDIN close the file descriptor
   if (user_infile) {
@@ -161,46 +267,32 @@ int main(int argc, char **argv) {
 
   // Stats calculation and output if flag is set in command line arguements
   uint64_t compressed = 0;
-  if (total_bits % 8 == 0) {
-    compressed = total_bits / 8;
+  if (c->total_bits % 8 == 0) {
+    compressed = c->total_bits / 8;
   } else {
-    compressed = total_bits / 8 + 1;
+    compressed = c->total_bits / 8 + 1;
   }
   if (Stats) {
     printf("Compressed file size: %lu bytes\n", compressed);
-    printf("Uncompressed file size: %lu bytes\n", total_syms);
+    printf("Uncompressed file size: %lu bytes\n", c->total_syms);
     printf("Compressed ratio: %.2lf%%\n",
-        100 * (1 - (compressed / 1.00) / total_syms));
+        100 * (1 - (compressed / 1.00) / c->total_syms));
+    stats_print(c->stats, &total, c->total_syms, c->resets);
+  }
+  if (metrics_file) {
+    stats_export(c, metrics_file, true, &total);
+  }
+  if (c->stats) {
+    stats_delete(c->stats);
   }
 
-  // Deallocate memory from Trie ADT, bit buffer, and File Header
-  trie_delete(root);
-  bv_delete(bitbuf);
+  // Deallocate memory from the encoder, shared dictionary and File Header
+  codec_delete(c);
+  free(shared);
   free(header);
   return 0;
 }
 
-//
-// This function simply identifies the minimum number
-// of bits needed for the code being passsed in
-//
-// uint16_t nex_code:           16 bit code integer
-//
-uint8_t bit_length(uint16_t next_code) {
-  uint8_t zeros = 0;
-  uint8_t bits = 0;
-  // Loop through all the bits in the code
-  for (int i = 0; i < 16; i++) {
-    zeros++;
-    // Check if each is on
-    if (next_code & (1 << i)) {
-      // Add the place of the bit
-      bits = zeros;
-    }
-  }
-  return bits;
-}
-
 //
 // This function parses through the command line arguments
 // and sets the appropriate flags for the program
@@ -230,6 +322,217 @@ void get_options(int argc, char **argv, char **read_file, char **write_file) {
       user_outfile = true;
       // Get the name of the text file and assign it to write_file
       (*write_file) = optarg;
+      // The frame size flag, given in KiB
+    } else if (c == 'b') {
+      user_frames = true;
+      uint64_t kib = strtoull(optarg, NULL, 10);
+      if (kib == 0 || kib * 1024 > FRAME_MAX) {
+        printf("Error: Frame size must be between 1 and %d KiB!\n",
+            FRAME_MAX / 1024);
+        exit(EXIT_FAILURE);
+      }
+      frame_size = kib * 1024;
+      // The threads flag
+    } else if (c == 't') {
+      user_frames = true;
+      threads = atoi(optarg);
+      // The metrics file flag
+    } else if (c == 'm') {
+      metrics_file = optarg;
+      // The trace flag, followed by the number of phrases between samples
+    } else if (c == 'T') {
+      trace_every = strtoull(optarg, NULL, 10);
+      if (trace_every == 0) {
+        printf("Error: Trace must sample at least every phrase!\n");
+        exit(EXIT_FAILURE);
+      }
+      // The code width flag, given in bits
+    } else if (c == 'w') {
+      char *end = NULL;
+      long bits = strtol(optarg, &end, 10);
+      if (end == optarg || *end != '\0' || bits < MIN_WIDTH
+          || bits > MAX_WIDTH) {
+        printf("Error: Code width must be between %d and %d bits!\n",
+            MIN_WIDTH, MAX_WIDTH);
+        exit(EXIT_FAILURE);
+      }
+      width = bits;
+      // The reset policy flag: full, freeze or adaptive with an optional
+      // threshold percentage, as in adaptive:10
+    } else if (c == 'r') {
+      char *pct = strchr(optarg, ':');
+      if (pct) {
+        *pct++ = '\0';
+      }
+      if (strcmp(optarg, "full") == 0 && !pct) {
+        policy = RESET_FULL;
+      } else if (strcmp(optarg, "freeze") == 0 && !pct) {
+        policy = RESET_FREEZE;
+      } else if (strcmp(optarg, "adaptive") == 0) {
+        policy = RESET_ADAPTIVE;
+        if (pct) {
+          int percent = atoi(pct);
+          if (percent < 1 || percent > 100) {
+            printf("Error: Reset threshold must be between 1 and 100%%!\n");
+            exit(EXIT_FAILURE);
+          }
+          threshold = percent;
+        }
+      } else {
+        printf("Error: Reset policy must be full, freeze or "
+               "adaptive[:percent]!\n");
+        exit(EXIT_FAILURE);
+      }
+      // The LZW flag
+    } else if (c == 'l') {
+      lzw = true;
+      // The entropy coding flag
+    } else if (c == 'e') {
+      entropy = true;
+      // The checksum flag
+    } else if (c == 'c') {
+      checksum = true;
+      // The seekable flag, which needs the framed format for the index
+    } else if (c == 's') {
+      user_frames = true;
+      seekable = true;
+      // The batch flag, followed by a directory or list of files
+    } else if (c == 'B') {
+      batch_path = optarg;
+      // The shared dictionary flag, followed by the path of the dictionary
+    } else if (c == 'D') {
+      shared_path = optarg;
+      // The training flag, followed by the size of the dictionary in KiB
+    } else if (c == 'X') {
+      uint64_t kib = strtoull(optarg, NULL, 10);
+      if (kib == 0 || kib * 1024 > SHARED_MAX) {
+        printf("Error: Dictionary size must be between 1 and %d KiB!\n",
+            SHARED_MAX / 1024);
+        exit(EXIT_FAILURE);
+      }
+      train_size = kib * 1024;
+      // The pipelined flag
+    } else if (c == 'P') {
+      pipelined = true;
     }
   }
+
+  // Training takes its samples from a batch and writes the dictionary
+  if (train_size && (!batch_path || !shared_path)) {
+    printf("Error: Training needs samples with -B and a dictionary path "
+           "with -D!\n");
+    exit(EXIT_FAILURE);
+  }
+
+  // A batch takes its files from the list and compresses each as a stream
+  // of its own
+  if (batch_path && user_infile) {
+    printf("Error: Batch mode reads its files from the list, "
+           "not the infile!\n");
+    exit(EXIT_FAILURE);
+  }
+  if (batch_path && seekable) {
+    printf("Error: Files of a batch can't be seekable!\n");
+    exit(EXIT_FAILURE);
+  }
+}
+
+//
+// Appends a path to an array of paths, doubling the array when it is full.
+//
+// files:   Array of paths.
+// n:       Pointer to the number of paths in the array.
+// cap:     Pointer to the number of paths allocated for the array.
+// file:    Path to append.
+// returns: Array of paths, which may have moved.
+//
+static char **add_file(char **files, uint32_t *n, uint32_t *cap, char *file) {
+  if (*n == *cap) {
+    *cap = *cap ? 2 * *cap : 64;
+    files = (char **)realloc(files, *cap * sizeof(char *));
+    if (!files) {
+      printf("Error: Failed to allocate memory for file names!\n");
+      exit(EXIT_FAILURE);
+    }
+  }
+  files[(*n)++] = file;
+  return files;
+}
+
+//
+// Gathers the paths of the files of a batch: every regular file in a
+// directory, in name order, or one path per line of a list of files, with
+// "-" being a list read from stdin. Files in a directory that already end
+// in BATCH_SUFFIX are left out.
+//
+// path:    Path of the directory or list.
+// n:       Pointer to store the number of paths into.
+// returns: Array of paths that has been allocated memory, as has each path.
+//
+char **batch_files(char *path, uint32_t *n) {
+  char **files = NULL;
+  uint32_t cap = 0;
+  *n = 0;
+
+  struct stat st;
+  bool dir = strcmp(path, "-") != 0 && stat(path, &st) == 0
+             && S_ISDIR(st.st_mode);
+  if (dir) {
+    struct dirent **entries = NULL;
+    int nentries = scandir(path, &entries, NULL, alphasort);
+    if (nentries < 0) {
+      printf("Error: Failed to read directory %s!\n", path);
+      exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < nentries; i++) {
+      const char *name = entries[i]->d_name;
+      size_t len = strlen(name);
+      size_t suffix = strlen(BATCH_SUFFIX);
+      char *file = (char *)malloc(strlen(path) + len + 2);
+      if (!file) {
+        printf("Error: Failed to allocate memory for file name!\n");
+        exit(EXIT_FAILURE);
+      }
+      sprintf(file, "%s/%s", path, name);
+      if (stat(file, &st) < 0 || !S_ISREG(st.st_mode)
+          || (len >= suffix
+              && strcmp(name + len - suffix, BATCH_SUFFIX) == 0)) {
+        free(file);
+      } else {
+        files = add_file(files, n, &cap, file);
+      }
+      free(entries[i]);
+    }
+    free(entries);
+    return files;
+  }
+
+  FILE *list = strcmp(path, "-") == 0 ? stdin : fopen(path, "r");
+  if (!list) {
+    printf("Error: Failed to open %s!\n", path);
+    exit(EXIT_FAILURE);
+  }
+  char *line = NULL;
+  size_t line_cap = 0;
+  ssize_t len = 0;
+  while ((len = getline(&line, &line_cap, list)) >= 0) {
+    // Lines are paths once their newline is dropped, empty ones are skipped
+    if (len > 0 && line[len - 1] == '\n') {
+      line[--len] = '\0';
+    }
+    if (len == 0) {
+      continue;
+    }
+    char *file = strdup(line);
+    if (!file) {
+      printf("Error: Failed to allocate memory for file name!\n");
+      exit(EXIT_FAILURE);
+    }
+    files = add_file(files, n, &cap, file);
+  }
+  free(line);
+  if (list != stdin) {
+    fclose(list);
+  }
+  return files;
 }
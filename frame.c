@@ -0,0 +1,910 @@
+#include "frame.h"
+#include "io.h"
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+//
+// Struct definition of a Job, one frame on its way through a Pool.
+//
+// in:        Bytes of the frame to process.
+// in_len:    Number of bytes in in.
+// in_cap:    Number of bytes allocated for in.
+// out:       Bytes the frame was processed into.
+// out_len:   Number of bytes in out.
+// out_cap:   Number of bytes allocated for out.
+// syms:      Number of uncompressed bytes the frame header promised.
+// name:      Path of the file of the Job in a batch, unused for a frame.
+// name_cap:  Number of bytes allocated for name.
+// mode:      Protection of the file of the Job in a batch.
+// done:      True once a thread has processed the frame.
+//
+typedef struct Job {
+  uint8_t *in;
+  uint32_t in_len;
+  uint32_t in_cap;
+  uint8_t *out;
+  uint64_t out_len;
+  uint64_t out_cap;
+  uint32_t syms;
+  char *name;
+  uint32_t name_cap;
+  uint16_t mode;
+  bool done;
+} Job;
+
+//
+// Struct definition of a Pool of threads that process Jobs in a ring.
+// Jobs are submitted, taken and written in the same order, so the slot of
+// a Job is only reused once it has been written out.
+//
+// lock:      Mutex that guards the counters and done flags.
+// work:      Signalled when a Job is submitted or the Pool stops.
+// done:      Signalled when a Job is done.
+// threads:   Array of threads.
+// nthreads:  Number of threads.
+// jobs:      Ring of Jobs.
+// slots:     Number of Jobs in the ring.
+// submitted: Number of Jobs submitted.
+// taken:     Number of Jobs taken by a thread.
+// written:   Number of Jobs written out.
+// encode:    True if the threads compress, false if they decompress.
+// stop:      True once there are no more Jobs to submit.
+// stats:     CodecStats the threads add theirs to when they finish, NULL for
+//            none.
+// resets:    Number of dictionary resets of all Jobs.
+// width:     Code width of the Codec of each thread.
+// policy:    Reset policy of the Codec of each thread.
+// threshold: Threshold of the reset policy of the Codec of each thread.
+// lzw:       True if the Codec of each thread uses LZW.
+// entropy:   True if the Codec of each thread entropy codes its pairs.
+// checksum:  True if the Codec of each thread checksums its frames.
+// shared:    Shared dictionary of the Codec of each thread, NULL for none.
+// shared_len: Number of bytes of the shared dictionary.
+//
+typedef struct Pool {
+  pthread_mutex_t lock;
+  pthread_cond_t work;
+  pthread_cond_t done;
+  pthread_t *threads;
+  int nthreads;
+  Job *jobs;
+  uint32_t slots;
+  uint64_t submitted;
+  uint64_t taken;
+  uint64_t written;
+  bool encode;
+  bool stop;
+  CodecStats *stats;
+  uint64_t resets;
+  uint8_t width;
+  uint8_t policy;
+  uint8_t threshold;
+  bool lzw;
+  bool entropy;
+  bool checksum;
+  const uint8_t *shared;
+  uint32_t shared_len;
+} Pool;
+
+//
+// Struct definition of an Index, the IndexEntries of the frames written so
+// far by an encoder.
+//
+// entries:   Array of IndexEntries.
+// len:       Number of IndexEntries in the array.
+// cap:       Number of IndexEntries allocated for the array.
+// syms:      Number of uncompressed bytes in the frames written so far.
+//
+typedef struct Index {
+  IndexEntry *entries;
+  uint32_t len;
+  uint32_t cap;
+  uint64_t syms;
+} Index;
+
+//
+// Processes a single Job with the Codec of a thread.
+// The Codec reads the input of the Job and writes into the output of the
+// Job, so no bytes are copied between the two.
+//
+// c:       Codec of the thread.
+// j:       Job to process.
+// encode:  True to compress, false to decompress.
+// returns: Void.
+//
+static void job_run(Codec *c, Job *j, bool encode) {
+  codec_reset(c);
+  c->in_mem = j->in;
+  c->in_len = j->in_len;
+  c->out_mem = j->out;
+  c->out_cap = j->out_cap;
+  if (encode) {
+    codec_encode(c);
+  } else {
+    codec_decode(c);
+  }
+
+  // Hand the output back to the Job, it may have been grown
+  j->out = c->out_mem;
+  j->out_cap = c->out_cap;
+  j->out_len = c->out_len;
+  c->out_mem = NULL;
+  c->out_cap = 0;
+  return;
+}
+
+//
+// Thread routine that takes Jobs from a Pool until it stops.
+//
+// arg:     Pool to take Jobs from.
+// returns: NULL.
+//
+static void *pool_worker(void *arg) {
+  Pool *p = (Pool *)arg;
+  Codec *c = p->encode ? encoder_create(MEM_FD, MEM_FD)
+                       : decoder_create(MEM_FD, MEM_FD);
+  codec_set_width(c, p->width);
+  codec_set_policy(c, p->policy, p->threshold);
+  codec_set_lzw(c, p->lzw);
+  codec_set_entropy(c, p->entropy);
+  codec_set_checksum(c, p->checksum);
+  if (p->shared) {
+    codec_set_shared(c, p->shared, p->shared_len);
+  }
+  if (p->stats) {
+    c->stats = stats_create();
+  }
+
+  pthread_mutex_lock(&p->lock);
+  while (true) {
+    // Wait until there is a Job to take or the Pool stops
+    while (p->taken == p->submitted && !p->stop) {
+      pthread_cond_wait(&p->work, &p->lock);
+    }
+    if (p->taken == p->submitted) {
+      break;
+    }
+    Job *j = &p->jobs[p->taken % p->slots];
+    p->taken++;
+
+    // Process the Job without holding the lock
+    pthread_mutex_unlock(&p->lock);
+    job_run(c, j, p->encode);
+    pthread_mutex_lock(&p->lock);
+
+    j->done = true;
+    p->resets += c->resets;
+    pthread_cond_broadcast(&p->done);
+  }
+  if (c->stats) {
+    stats_merge(p->stats, c->stats);
+    stats_delete(c->stats);
+  }
+  pthread_mutex_unlock(&p->lock);
+
+  codec_delete(c);
+  return NULL;
+}
+
+//
+// Constructor for a Pool, which also starts its threads.
+//
+// nthreads:  Number of threads to start.
+// encode:    True if the threads compress, false if they decompress.
+// c:         Codec whose CodecStats the threads add theirs to, and whose code
+//            width and reset policy the Codec of each thread takes.
+// returns:   Pointer to a Pool that has been allocated memory.
+//
+static Pool *pool_create(int nthreads, bool encode, Codec *c) {
+  Pool *p = (Pool *)calloc(1, sizeof(Pool));
+  if (!p) {
+    printf("Error: Failed to allocate memory for Pool!\n");
+    exit(EXIT_FAILURE);
+  }
+  p->nthreads = nthreads;
+  p->encode = encode;
+  p->stats = c->stats;
+  p->width = c->width;
+  p->policy = c->policy;
+  p->threshold = c->threshold;
+  p->lzw = c->lzw;
+  p->entropy = c->entropy;
+  p->checksum = c->checksum;
+  p->shared = c->shared;
+  p->shared_len = c->shared_len;
+
+  // Twice as many slots as threads lets the next frames be read in while
+  // every thread is busy
+  p->slots = 2 * nthreads;
+  p->jobs = (Job *)calloc(p->slots, sizeof(Job));
+  p->threads = (pthread_t *)calloc(nthreads, sizeof(pthread_t));
+  if (!p->jobs || !p->threads) {
+    printf("Error: Failed to allocate memory for Pool!\n");
+    exit(EXIT_FAILURE);
+  }
+
+  pthread_mutex_init(&p->lock, NULL);
+  pthread_cond_init(&p->work, NULL);
+  pthread_cond_init(&p->done, NULL);
+  for (int i = 0; i < nthreads; i++) {
+    if (pthread_create(&p->threads[i], NULL, pool_worker, p)) {
+      printf("Error: Failed to create thread!\n");
+      exit(EXIT_FAILURE);
+    }
+  }
+  return p;
+}
+
+//
+// Destructor for a Pool, which first waits for its threads to finish.
+//
+// p:       Pool to free allocated memory for.
+// returns: Void.
+//
+static void pool_delete(Pool *p) {
+  pthread_mutex_lock(&p->lock);
+  p->stop = true;
+  pthread_cond_broadcast(&p->work);
+  pthread_mutex_unlock(&p->lock);
+  for (int i = 0; i < p->nthreads; i++) {
+    pthread_join(p->threads[i], NULL);
+  }
+
+  for (uint32_t i = 0; i < p->slots; i++) {
+    free(p->jobs[i].in);
+    free(p->jobs[i].out);
+    free(p->jobs[i].name);
+  }
+  pthread_mutex_destroy(&p->lock);
+  pthread_cond_destroy(&p->work);
+  pthread_cond_destroy(&p->done);
+  free(p->jobs);
+  free(p->threads);
+  free(p);
+  return;
+}
+
+//
+// Returns the slot of the next Job to submit, with room for len input bytes.
+//
+// p:       Pool to submit to.
+// len:     Number of input bytes the Job needs room for.
+// returns: Pointer to the Job.
+//
+static Job *pool_next(Pool *p, uint32_t len) {
+  Job *j = &p->jobs[p->submitted % p->slots];
+  if (j->in_cap < len) {
+    j->in_cap = len;
+    j->in = (uint8_t *)realloc(j->in, j->in_cap);
+    if (!j->in) {
+      printf("Error: Failed to allocate memory for frame!\n");
+      exit(EXIT_FAILURE);
+    }
+  }
+  return j;
+}
+
+//
+// Submits the Job returned by the last call to pool_next().
+//
+// p:       Pool to submit to.
+// returns: Void.
+//
+static void pool_submit(Pool *p) {
+  pthread_mutex_lock(&p->lock);
+  p->jobs[p->submitted % p->slots].done = false;
+  p->submitted++;
+  pthread_cond_signal(&p->work);
+  pthread_mutex_unlock(&p->lock);
+  return;
+}
+
+//
+// Waits for the oldest Job that hasn't been written out to be done.
+//
+// p:       Pool to wait on.
+// returns: Pointer to the Job, which the caller must write out.
+//
+static Job *pool_wait(Pool *p) {
+  Job *j = &p->jobs[p->written % p->slots];
+  pthread_mutex_lock(&p->lock);
+  while (!j->done) {
+    pthread_cond_wait(&p->done, &p->lock);
+  }
+  pthread_mutex_unlock(&p->lock);
+  p->written++;
+  return j;
+}
+
+//
+// Adds the IndexEntry of a frame that is about to be written to an Index.
+//
+// x:       Index to add to.
+// syms:    Number of uncompressed bytes in the frame.
+// offset:  Offset of the FrameHeader of the frame in the file.
+// returns: Void.
+//
+static void index_add(Index *x, uint32_t syms, uint64_t offset) {
+  if (x->len == x->cap) {
+    x->cap = x->cap ? 2 * x->cap : 64;
+    x->entries = (IndexEntry *)realloc(x->entries,
+        x->cap * sizeof(IndexEntry));
+    if (!x->entries) {
+      printf("Error: Failed to allocate memory for Index!\n");
+      exit(EXIT_FAILURE);
+    }
+  }
+  x->entries[x->len].syms_offset = x->syms;
+  x->entries[x->len].bytes_offset = offset;
+  x->len++;
+  x->syms += syms;
+  return;
+}
+
+//
+// Writes out the IndexEntries of an Index followed by the IndexFooter.
+//
+// c:       Codec whose output file to write to.
+// x:       Index to write.
+// returns: Void.
+//
+static void index_write(Codec *c, Index *x) {
+  IndexFooter footer = { INDEX_MAGIC, x->len };
+  write_bytes(c, (uint8_t *)x->entries, x->len * sizeof(IndexEntry));
+  write_bytes(c, (uint8_t *)&footer, sizeof(IndexFooter));
+  c->total_bits += (x->len * sizeof(IndexEntry) + sizeof(IndexFooter)) * 8;
+  return;
+}
+
+//
+// Writes out the oldest compressed frame of a Pool.
+//
+// c:       Codec whose output file to write to.
+// p:       Pool of compressing threads.
+// x:       Index to add the frame to, NULL for none.
+// returns: Void.
+//
+static void frame_write(Codec *c, Pool *p, Index *x) {
+  Job *j = pool_wait(p);
+  if (x) {
+    index_add(x, j->in_len, c->total_bits / 8);
+  }
+  FrameHeader fh = { j->in_len, (uint32_t)j->out_len };
+  write_bytes(c, (uint8_t *)&fh, sizeof(FrameHeader));
+  write_bytes(c, j->out, j->out_len);
+  c->total_bits += (sizeof(FrameHeader) + j->out_len) * 8;
+  return;
+}
+
+//
+// Compresses everything left in the input file of a Codec into frames.
+// Frames are compressed by a pool of threads and written out in order.
+// The FileHeader is not written.
+//
+// c:           Codec whose files to read from and write to.
+// frame_size:  Number of uncompressed bytes in each frame.
+// threads:     Number of threads that compress frames.
+// index:       True to write an index of the frames after the empty frame.
+// returns:     Void.
+//
+void frame_encode(Codec *c, uint32_t frame_size, int threads, bool index) {
+  Pool *p = pool_create(threads, true, c);
+  Index x = { NULL, 0, 0, 0 };
+  Index *xp = index ? &x : NULL;
+
+  // Loop until there is nothing left to read
+  while (true) {
+    // Write out the oldest frame if every slot is in use
+    if (p->submitted - p->written == p->slots) {
+      frame_write(c, p, xp);
+    }
+
+    Job *j = pool_next(p, frame_size);
+    j->in_len = read_bytes(c, j->in, frame_size);
+    c->total_syms += j->in_len;
+    if (j->in_len == 0) {
+      break;
+    }
+    pool_submit(p);
+  }
+
+  // Write out the frames still in the Pool followed by the empty frame
+  while (p->written < p->submitted) {
+    frame_write(c, p, xp);
+  }
+  FrameHeader fh = { 0, 0 };
+  write_bytes(c, (uint8_t *)&fh, sizeof(FrameHeader));
+  c->total_bits += sizeof(FrameHeader) * 8;
+  if (index) {
+    index_write(c, &x);
+    free(x.entries);
+  }
+
+  c->resets += p->resets;
+  pool_delete(p);
+  return;
+}
+
+//
+// Writes out the oldest decompressed frame of a Pool.
+//
+// c:       Codec whose output file to write to.
+// p:       Pool of decompressing threads.
+// returns: Void.
+//
+static void frame_flush(Codec *c, Pool *p) {
+  Job *j = pool_wait(p);
+  if (j->out_len != j->syms) {
+    printf("Error: Corrupted frame in infile!\n");
+    exit(EXIT_FAILURE);
+  }
+  write_bytes(c, j->out, j->out_len);
+  c->total_syms += j->out_len;
+  return;
+}
+
+//
+// Decompresses the frames in the input file of a Codec.
+// Frames are decompressed by a pool of threads and written out in order.
+// The FileHeader must already have been read.
+//
+// c:           Codec whose files to read from and write to.
+// threads:     Number of threads that decompress frames.
+// returns:     Void.
+//
+void frame_decode(Codec *c, int threads) {
+  Pool *p = pool_create(threads, false, c);
+
+  // Loop until the empty frame is read
+  while (true) {
+    // Write out the oldest frame if every slot is in use
+    if (p->submitted - p->written == p->slots) {
+      frame_flush(c, p);
+    }
+
+    FrameHeader fh;
+    if (read_bytes(c, (uint8_t *)&fh, sizeof(FrameHeader))
+        != sizeof(FrameHeader)) {
+      printf("Error: Truncated frame in infile!\n");
+      exit(EXIT_FAILURE);
+    }
+    c->total_bits += sizeof(FrameHeader) * 8;
+    if (fh.syms == 0 && fh.bytes == 0) {
+      break;
+    }
+    if (fh.syms > FRAME_MAX || fh.bytes > FRAME_BOUND(fh.syms)) {
+      printf("Error: Corrupted frame in infile!\n");
+      exit(EXIT_FAILURE);
+    }
+
+    Job *j = pool_next(p, fh.bytes);
+    j->in_len = read_bytes(c, j->in, fh.bytes);
+    if (j->in_len != fh.bytes) {
+      printf("Error: Truncated frame in infile!\n");
+      exit(EXIT_FAILURE);
+    }
+    c->total_bits += (uint64_t)fh.bytes * 8;
+    j->syms = fh.syms;
+    pool_submit(p);
+  }
+
+  // Write out the frames still in the Pool
+  while (p->written < p->submitted) {
+    frame_flush(c, p);
+  }
+
+  c->resets += p->resets;
+  pool_delete(p);
+  return;
+}
+
+//
+// Reads bytes at an offset of the input file of a Codec, exiting if the
+// file is shorter.
+//
+// c:       Codec whose input file to read from.
+// offset:  Offset in the file of the first byte to read.
+// buf:     Buffer to store the read bytes into.
+// len:     Number of bytes to read.
+// returns: Void.
+//
+static void read_at(Codec *c, uint64_t offset, uint8_t *buf, uint64_t len) {
+  if (lseek(c->infile, offset, SEEK_SET) < 0
+      || (uint64_t)read_bytes(c, buf, len) != len) {
+    printf("Error: Truncated index in infile!\n");
+    exit(EXIT_FAILURE);
+  }
+  return;
+}
+
+//
+// Decompresses a range of the uncompressed bytes of an indexed stream. The
+// index is read from the end of the input file, which therefore has to be
+// seekable, and only the frames that hold the range are read and
+// decompressed. A range past the end of the stream is cut short.
+// The FileHeader must already have been read.
+//
+// c:       Codec whose files to read from and write to.
+// start:   Offset of the first uncompressed byte of the range.
+// len:     Number of uncompressed bytes in the range.
+// returns: Void.
+//
+void frame_decode_range(Codec *c, uint64_t start, uint64_t len) {
+  off_t end = lseek(c->infile, 0, SEEK_END);
+  if (end < 0) {
+    printf("Error: Infile must be seekable to decode a range!\n");
+    exit(EXIT_FAILURE);
+  }
+
+  // The footer ends the file and the entries come right before it
+  IndexFooter footer = { 0, 0 };
+  uint64_t index_len = sizeof(FileHeader) + sizeof(IndexFooter);
+  if ((uint64_t)end >= index_len) {
+    read_at(c, end - sizeof(IndexFooter), (uint8_t *)&footer,
+        sizeof(IndexFooter));
+  }
+  index_len += (uint64_t)footer.frames * sizeof(IndexEntry);
+  if (footer.magic != INDEX_MAGIC || index_len > (uint64_t)end) {
+    printf("Error: Corrupted index in infile!\n");
+    exit(EXIT_FAILURE);
+  }
+  IndexEntry *entries = (IndexEntry *)malloc(
+      (uint64_t)footer.frames * sizeof(IndexEntry) + 1);
+  if (!entries) {
+    printf("Error: Failed to allocate memory for Index!\n");
+    exit(EXIT_FAILURE);
+  }
+  read_at(c, end - index_len + sizeof(FileHeader), (uint8_t *)entries,
+      (uint64_t)footer.frames * sizeof(IndexEntry));
+  c->total_bits += (index_len - sizeof(FileHeader)) * 8;
+
+  // Find the last frame that starts at or before the range
+  uint32_t lo = 0;
+  uint32_t hi = footer.frames;
+  while (hi - lo > 1) {
+    uint32_t mid = lo + (hi - lo) / 2;
+    if (entries[mid].syms_offset <= start) {
+      lo = mid;
+    } else {
+      hi = mid;
+    }
+  }
+
+  // Decompress the frames from there until the range is written out
+  Codec *d = decoder_create(MEM_FD, MEM_FD);
+  codec_set_width(d, c->width);
+  codec_set_policy(d, c->policy, c->threshold);
+  codec_set_lzw(d, c->lzw);
+  codec_set_entropy(d, c->entropy);
+  codec_set_checksum(d, c->checksum);
+  if (c->shared) {
+    codec_set_shared(d, c->shared, c->shared_len);
+  }
+  uint8_t *in = NULL;
+  uint64_t stop = start + len < start ? UINT64_MAX : start + len;
+  for (uint32_t i = lo; i < footer.frames; i++) {
+    uint64_t first = entries[i].syms_offset;
+    if (first >= stop) {
+      break;
+    }
+    FrameHeader fh;
+    read_at(c, entries[i].bytes_offset, (uint8_t *)&fh, sizeof(FrameHeader));
+    if (fh.syms > FRAME_MAX || fh.bytes > FRAME_BOUND(fh.syms)) {
+      printf("Error: Corrupted frame in infile!\n");
+      exit(EXIT_FAILURE);
+    }
+    if (first + fh.syms <= start) {
+      continue;
+    }
+    in = (uint8_t *)realloc(in, (uint64_t)fh.bytes + 1);
+    if (!in) {
+      printf("Error: Failed to allocate memory for frame!\n");
+      exit(EXIT_FAILURE);
+    }
+    read_at(c, entries[i].bytes_offset + sizeof(FrameHeader), in, fh.bytes);
+    c->total_bits += (sizeof(FrameHeader) + (uint64_t)fh.bytes) * 8;
+
+    codec_reset(d);
+    d->in_mem = in;
+    d->in_len = fh.bytes;
+    codec_decode(d);
+    if (d->out_len != fh.syms) {
+      printf("Error: Corrupted frame in infile!\n");
+      exit(EXIT_FAILURE);
+    }
+
+    // Write out the part of the frame inside the range
+    uint64_t from = start > first ? start - first : 0;
+    uint64_t to = stop - first < fh.syms ? stop - first : fh.syms;
+    write_bytes(c, d->out_mem + from, to - from);
+    c->total_syms += to - from;
+    c->resets += d->resets;
+  }
+
+  free(in);
+  free(entries);
+  codec_delete(d);
+  return;
+}
+
+//
+// Checks that the path of a member of an archive stays below the directory
+// it is extracted to: it must not be empty or absolute, and none of its
+// parts may be "..".
+//
+// name:    Path of the member.
+// returns: True if the path is safe to extract to, false otherwise.
+//
+static bool member_safe(const char *name) {
+  if (name[0] == '\0' || name[0] == '/') {
+    return false;
+  }
+  for (const char *part = name; part; part = strchr(part, '/')) {
+    part += *part == '/';
+    if (strncmp(part, "..", 2) == 0 && (part[2] == '/' || part[2] == '\0')) {
+      return false;
+    }
+  }
+  return true;
+}
+
+//
+// Makes room in the name of a Job for a path of len bytes, along with the
+// suffix added to the outfiles of a batch and the terminating null byte.
+//
+// j:       Job whose name to grow.
+// len:     Number of bytes of the path.
+// returns: Void.
+//
+static void job_name(Job *j, uint32_t len) {
+  if (j->name_cap < len + sizeof(BATCH_SUFFIX)) {
+    j->name_cap = len + sizeof(BATCH_SUFFIX);
+    j->name = (char *)realloc(j->name, j->name_cap);
+    if (!j->name) {
+      printf("Error: Failed to allocate memory for file name!\n");
+      exit(EXIT_FAILURE);
+    }
+  }
+  return;
+}
+
+//
+// Writes out the oldest compressed file of a batch, either to a file of its
+// own or as a member of the archive in the output file of a Codec.
+//
+// c:         Codec whose output file is the archive.
+// p:         Pool of compressing threads.
+// header:    FileHeader of each file of its own, the protection is replaced.
+// archive:   True to write a member of the archive, false for a file.
+// returns:   Void.
+//
+static void batch_write(Codec *c, Pool *p, FileHeader *header, bool archive) {
+  Job *j = pool_wait(p);
+  if (archive) {
+    MemberHeader mh = { j->in_len, (uint32_t)j->out_len,
+                        (uint16_t)strlen(j->name), j->mode };
+    write_bytes(c, (uint8_t *)&mh, sizeof(MemberHeader));
+    write_bytes(c, (uint8_t *)j->name, mh.name_len);
+    write_bytes(c, j->out, j->out_len);
+    c->total_bits += (sizeof(MemberHeader) + mh.name_len + j->out_len) * 8;
+    return;
+  }
+
+  // The outfile is the file with the suffix added and its protection
+  strcat(j->name, BATCH_SUFFIX);
+  int outfile = open(j->name, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+  if (outfile < 0) {
+    printf("Error: Failed to open %s!\n", j->name);
+    exit(EXIT_FAILURE);
+  }
+  int archive_fd = c->outfile;
+  c->outfile = outfile;
+  header->protection = j->mode;
+  write_header(c, header);
+  write_bytes(c, j->out, j->out_len);
+  c->total_bits += j->out_len * 8;
+  fchmod(outfile, j->mode);
+  if (close(outfile) < 0) {
+    printf("Error: Failed to close %s!\n", j->name);
+    exit(EXIT_FAILURE);
+  }
+  c->outfile = archive_fd;
+  return;
+}
+
+//
+// Compresses a batch of files in one process, each into a stream of its
+// own. Files are read in order and compressed by a pool of threads, whose
+// Codecs are reset between files rather than created anew for each. Each
+// file is written to its path with BATCH_SUFFIX added, or all of them as
+// the members of an archive in the output file of the Codec, ended by an
+// empty MemberHeader. The FileHeader of an archive is not written.
+//
+// c:         Codec whose output file is the archive, and whose settings the
+//            Codec of each thread takes.
+// header:    FileHeader of each file of its own, unused for an archive.
+// paths:     Paths of the files to compress.
+// n:         Number of paths.
+// threads:   Number of threads that compress files.
+// archive:   True to write an archive, false to write a file for each file.
+// returns:   Void.
+//
+void batch_encode(Codec *c, FileHeader *header, char **paths, uint32_t n,
+    int threads, bool archive) {
+  Pool *p = pool_create(threads, true, c);
+  int infile = c->infile;
+
+  for (uint32_t i = 0; i < n; i++) {
+    // Write out the oldest file if every slot is in use
+    if (p->submitted - p->written == p->slots) {
+      batch_write(c, p, header, archive);
+    }
+
+    // Members are stored without a leading slash, so that they extract
+    // below the directory they are extracted to
+    const char *name = paths[i];
+    while (archive && *name == '/') {
+      name++;
+    }
+    if (archive && (strlen(name) > UINT16_MAX || !member_safe(name))) {
+      printf("Error: %s can't be a member of an archive!\n", paths[i]);
+      exit(EXIT_FAILURE);
+    }
+
+    struct stat st;
+    c->infile = open(paths[i], O_RDONLY);
+    if (c->infile < 0 || fstat(c->infile, &st) < 0) {
+      printf("Error: Failed to open %s!\n", paths[i]);
+      exit(EXIT_FAILURE);
+    }
+    if (!S_ISREG(st.st_mode) || st.st_size > FRAME_MAX) {
+      printf("Error: %s must be a regular file of at most %d MiB!\n",
+          paths[i], FRAME_MAX >> 20);
+      exit(EXIT_FAILURE);
+    }
+
+    // Read the whole file into the Job, one more byte than it has so an
+    // empty file still gets a buffer
+    Job *j = pool_next(p, st.st_size + 1);
+    j->in_len = read_bytes(c, j->in, st.st_size);
+    close(c->infile);
+    c->total_syms += j->in_len;
+    job_name(j, strlen(name));
+    strcpy(j->name, name);
+    j->mode = st.st_mode;
+    pool_submit(p);
+  }
+
+  // Write out the files still in the Pool, and end an archive
+  while (p->written < p->submitted) {
+    batch_write(c, p, header, archive);
+  }
+  if (archive) {
+    MemberHeader mh = { 0, 0, 0, 0 };
+    write_bytes(c, (uint8_t *)&mh, sizeof(MemberHeader));
+    c->total_bits += sizeof(MemberHeader) * 8;
+  }
+
+  c->infile = infile;
+  c->resets += p->resets;
+  pool_delete(p);
+  return;
+}
+
+//
+// Writes out the oldest decompressed member of an archive to its file,
+// making the directories on its path that don't exist yet.
+//
+// c:       Codec whose counters to add to.
+// p:       Pool of decompressing threads.
+// returns: Void.
+//
+static void batch_flush(Codec *c, Pool *p) {
+  Job *j = pool_wait(p);
+  if (j->out_len != j->syms) {
+    printf("Error: Corrupted member in infile!\n");
+    exit(EXIT_FAILURE);
+  }
+  for (char *slash = strchr(j->name + 1, '/'); slash;
+       slash = strchr(slash + 1, '/')) {
+    *slash = '\0';
+    mkdir(j->name, S_IRWXU | S_IRGRP | S_IXGRP | S_IROTH | S_IXOTH);
+    *slash = '/';
+  }
+
+  int outfile = open(j->name, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+  if (outfile < 0) {
+    printf("Error: Failed to open %s!\n", j->name);
+    exit(EXIT_FAILURE);
+  }
+  int stdout_fd = c->outfile;
+  c->outfile = outfile;
+  write_bytes(c, j->out, j->out_len);
+  c->total_syms += j->out_len;
+  fchmod(outfile, j->mode);
+  if (close(outfile) < 0) {
+    printf("Error: Failed to close %s!\n", j->name);
+    exit(EXIT_FAILURE);
+  }
+  c->outfile = stdout_fd;
+  return;
+}
+
+//
+// Decompresses the members of an archive in the input file of a Codec,
+// each into the file at its path below a directory. Members are
+// decompressed by a pool of threads and written out in order.
+// The FileHeader must already have been read.
+//
+// c:         Codec whose input file to read from.
+// threads:   Number of threads that decompress members.
+// dir:       Directory to extract the members below, NULL for the current one.
+// returns:   Void.
+//
+void batch_decode(Codec *c, int threads, const char *dir) {
+  Pool *p = pool_create(threads, false, c);
+  uint32_t dir_len = dir ? strlen(dir) + 1 : 0;
+
+  // Loop until the empty member is read
+  while (true) {
+    // Write out the oldest member if every slot is in use
+    if (p->submitted - p->written == p->slots) {
+      batch_flush(c, p);
+    }
+
+    MemberHeader mh;
+    if (read_bytes(c, (uint8_t *)&mh, sizeof(MemberHeader))
+        != sizeof(MemberHeader)) {
+      printf("Error: Truncated member in infile!\n");
+      exit(EXIT_FAILURE);
+    }
+    c->total_bits += sizeof(MemberHeader) * 8;
+    if (mh.name_len == 0) {
+      break;
+    }
+    if (mh.syms > FRAME_MAX || mh.bytes > FRAME_BOUND(mh.syms)) {
+      printf("Error: Corrupted member in infile!\n");
+      exit(EXIT_FAILURE);
+    }
+
+    // The path of the member follows the directory in the name of the Job
+    Job *j = pool_next(p, mh.bytes);
+    job_name(j, dir_len + mh.name_len);
+    if (dir) {
+      strcpy(j->name, dir);
+      j->name[dir_len - 1] = '/';
+    }
+    char *name = j->name + dir_len;
+    int name_len = read_bytes(c, (uint8_t *)name, mh.name_len);
+    name[mh.name_len] = '\0';
+    if (name_len != mh.name_len || strlen(name) != mh.name_len
+        || !member_safe(name)) {
+      printf("Error: Corrupted member name in infile!\n");
+      exit(EXIT_FAILURE);
+    }
+    j->in_len = read_bytes(c, j->in, mh.bytes);
+    if (j->in_len != mh.bytes) {
+      printf("Error: Truncated member in infile!\n");
+      exit(EXIT_FAILURE);
+    }
+    c->total_bits += ((uint64_t)mh.name_len + mh.bytes) * 8;
+    j->syms = mh.syms;
+    j->mode = mh.protection;
+    pool_submit(p);
+  }
+
+  // Write out the members still in the Pool
+  while (p->written < p->submitted) {
+    batch_flush(c, p);
+  }
+
+  c->resets += p->resets;
+  pool_delete(p);
+  return;
+}
@@ -0,0 +1,167 @@
+#ifndef __FRAME_H__
+#define __FRAME_H__
+
+#include "codec.h"
+#include "io.h"
+#include <inttypes.h>
+
+//
+// Default and largest number of uncompressed bytes in a frame.
+//
+#define FRAME_SIZE (1 << 20)
+#define FRAME_MAX (1 << 30)
+
+//
+// Largest number of compressed bytes of a frame or member of syms bytes.
+// Every byte takes at most one pair of MAX_WIDTH bits and a symbol, and
+// every block of an entropy coded stream, the STOP_CODE and the checksum
+// take a few bytes more. A decoder rejects a header stating more before
+// allocating anything for it.
+//
+#define FRAME_BOUND(syms) \
+  ((uint64_t)(syms) * ((MAX_WIDTH + 8 + 7) / 8) \
+      + ((uint64_t)(syms) / BLOCK_PAIRS + 4) * 16)
+
+//
+// Struct definition of a FrameHeader.
+// A stream with the magic number FRAME_MAGIC is a sequence of frames.
+// Each frame is a FrameHeader followed by the pairs of one input block,
+// compressed with a fresh dictionary and ended with its own STOP_CODE.
+// The last frame has zero symbols and zero bytes.
+//
+// syms:    Number of uncompressed bytes in the frame.
+// bytes:   Number of compressed bytes that follow the FrameHeader.
+//
+typedef struct FrameHeader {
+  uint32_t syms;
+  uint32_t bytes;
+} FrameHeader;
+
+//
+// Magic number of the IndexFooter that ends an indexed stream.
+//
+#define INDEX_MAGIC 0x8badd00d
+
+//
+// Struct definition of an IndexEntry, where a frame of an indexed stream
+// starts. A framed stream with FLAG_INDEX has an IndexEntry for every frame
+// after its empty frame, in order, followed by an IndexFooter. The footer
+// is found from the end of the file, so the frames that hold a range of the
+// uncompressed bytes can be read without reading the frames before them.
+//
+// syms_offset:   Offset of the first uncompressed byte of the frame.
+// bytes_offset:  Offset of the FrameHeader of the frame in the file.
+//
+typedef struct IndexEntry {
+  uint64_t syms_offset;
+  uint64_t bytes_offset;
+} IndexEntry;
+
+//
+// Struct definition of an IndexFooter, the last bytes of an indexed stream.
+//
+// magic:   INDEX_MAGIC.
+// frames:  Number of IndexEntries before the IndexFooter.
+//
+typedef struct IndexFooter {
+  uint32_t magic;
+  uint32_t frames;
+} IndexFooter;
+
+//
+// Suffix added to the path of each file of a batch for its outfile.
+//
+#define BATCH_SUFFIX ".lz"
+
+//
+// Struct definition of a MemberHeader.
+// A stream with the magic number ARCHIVE_MAGIC is a sequence of members,
+// the files of a batch. Each member is a MemberHeader followed by the path
+// of the file, with no terminating null byte, and the pairs of the file,
+// compressed with a fresh dictionary and ended with its own STOP_CODE.
+// The last member has a path of zero bytes and nothing else.
+//
+// syms:        Number of uncompressed bytes in the file.
+// bytes:       Number of compressed bytes that follow the path.
+// name_len:    Number of bytes of the path.
+// protection:  Protection/permissions of the file.
+//
+typedef struct MemberHeader {
+  uint32_t syms;
+  uint32_t bytes;
+  uint16_t name_len;
+  uint16_t protection;
+} MemberHeader;
+
+//
+// Compresses everything left in the input file of a Codec into frames.
+// Frames are compressed by a pool of threads and written out in order.
+// The FileHeader is not written.
+//
+// c:           Codec whose files to read from and write to.
+// frame_size:  Number of uncompressed bytes in each frame.
+// threads:     Number of threads that compress frames.
+// index:       True to write an index of the frames after the empty frame.
+// returns:     Void.
+//
+void frame_encode(Codec *c, uint32_t frame_size, int threads, bool index);
+
+//
+// Decompresses the frames in the input file of a Codec.
+// Frames are decompressed by a pool of threads and written out in order.
+// The FileHeader must already have been read.
+//
+// c:           Codec whose files to read from and write to.
+// threads:     Number of threads that decompress frames.
+// returns:     Void.
+//
+void frame_decode(Codec *c, int threads);
+
+//
+// Decompresses a range of the uncompressed bytes of an indexed stream. The
+// index is read from the end of the input file, which therefore has to be
+// seekable, and only the frames that hold the range are read and
+// decompressed. A range past the end of the stream is cut short.
+// The FileHeader must already have been read.
+//
+// c:       Codec whose files to read from and write to.
+// start:   Offset of the first uncompressed byte of the range.
+// len:     Number of uncompressed bytes in the range.
+// returns: Void.
+//
+void frame_decode_range(Codec *c, uint64_t start, uint64_t len);
+
+//
+// Compresses a batch of files in one process, each into a stream of its
+// own. Files are read in order and compressed by a pool of threads, whose
+// Codecs are reset between files rather than created anew for each. Each
+// file is written to its path with BATCH_SUFFIX added, or all of them as
+// the members of an archive in the output file of the Codec, ended by an
+// empty MemberHeader. The FileHeader of an archive is not written.
+//
+// c:         Codec whose output file is the archive, and whose settings the
+//            Codec of each thread takes.
+// header:    FileHeader of each file of its own, unused for an archive.
+// paths:     Paths of the files to compress.
+// n:         Number of paths.
+// threads:   Number of threads that compress files.
+// archive:   True to write an archive, false to write a file for each file.
+// returns:   Void.
+//
+void batch_encode(Codec *c, FileHeader *header, char **paths, uint32_t n,
+    int threads, bool archive);
+
+//
+// Decompresses the members of an archive in the input file of a Codec,
+// each into the file at its path below a directory. Members are
+// decompressed by a pool of threads and written out in order.
+// The FileHeader must already have been read.
+//
+// c:         Codec whose input file to read from.
+// threads:   Number of threads that decompress members.
+// dir:       Directory to extract the members below, NULL for the current one.
+// returns:   Void.
+//
+void batch_decode(Codec *c, int threads, const char *dir);
+
+#endif
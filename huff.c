@@ -0,0 +1,179 @@
+#include "huff.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+//
+// Compares two leaves of a Huffman tree, each the count of a symbol in the
+// upper bits and the symbol in the lower 8 bits, for qsort().
+//
+// a:       First leaf.
+// b:       Second leaf.
+// returns: Negative, zero or positive as a is less, equal or greater.
+//
+static int leaf_cmp(const void *a, const void *b) {
+  uint64_t x = *(const uint64_t *)a;
+  uint64_t y = *(const uint64_t *)b;
+  return (x > y) - (x < y);
+}
+
+//
+// Finds the depth of every leaf of a Huffman tree for the given counts.
+// Leaves are sorted by count, so the tree is built with two queues, one of
+// the leaves and one of the inner nodes in the order they are made.
+//
+// lens:    Array to store the depth of each symbol into.
+// freq:    Number of times each symbol occurs.
+// nsyms:   Number of symbols of the alphabet.
+// returns: Depth of the deepest leaf.
+//
+static uint32_t huff_depths(uint8_t *lens, const uint32_t *freq,
+    uint32_t nsyms) {
+  uint64_t leaves[HUFF_SYMS];
+  uint64_t weight[2 * HUFF_SYMS];
+  uint32_t parent[2 * HUFF_SYMS];
+  uint32_t depth[2 * HUFF_SYMS];
+  uint32_t n = 0;
+
+  memset(lens, 0, nsyms);
+  for (uint32_t s = 0; s < nsyms; s++) {
+    if (freq[s]) {
+      leaves[n++] = (uint64_t)freq[s] << 8 | s;
+    }
+  }
+  // A single symbol still needs a code of one bit
+  if (n == 1) {
+    lens[leaves[0] & 0xFF] = 1;
+    return 1;
+  }
+  if (n == 0) {
+    return 0;
+  }
+  qsort(leaves, n, sizeof(uint64_t), leaf_cmp);
+  for (uint32_t i = 0; i < n; i++) {
+    weight[i] = leaves[i] >> 8;
+  }
+
+  // Join the two lightest nodes until only the root is left
+  uint32_t leaf = 0;
+  uint32_t inner = n;
+  for (uint32_t next = n; next < 2 * n - 1; next++) {
+    for (int k = 0; k < 2; k++) {
+      uint32_t pick = 0;
+      if (leaf < n && (inner == next || weight[leaf] <= weight[inner])) {
+        pick = leaf++;
+      } else {
+        pick = inner++;
+      }
+      parent[pick] = next;
+      weight[next] = k ? weight[next] + weight[pick] : weight[pick];
+    }
+  }
+
+  // A parent is always made after its children, so walk down from the root
+  uint32_t max = 0;
+  depth[2 * n - 2] = 0;
+  for (int i = 2 * n - 3; i >= 0; i--) {
+    depth[i] = depth[parent[i]] + 1;
+  }
+  for (uint32_t i = 0; i < n; i++) {
+    lens[leaves[i] & 0xFF] = depth[i];
+    max = depth[i] > max ? depth[i] : max;
+  }
+  return max;
+}
+
+//
+// Assigns the canonical codes of a HuffTable from its code lengths: codes of
+// the same length are consecutive in symbol order, and shorter codes come
+// before longer ones.
+//
+// h:       HuffTable with nsyms and lens set.
+// returns: False if the lengths are too many for a prefix code, true otherwise.
+//
+static bool huff_codes(HuffTable *h) {
+  uint32_t count[HUFF_MAX_BITS + 1] = { 0 };
+  uint32_t next[HUFF_MAX_BITS + 1] = { 0 };
+  for (uint32_t s = 0; s < h->nsyms; s++) {
+    count[h->lens[s]]++;
+  }
+  count[0] = 0;
+  uint32_t code = 0;
+  for (uint32_t len = 1; len <= HUFF_MAX_BITS; len++) {
+    code = (code + count[len - 1]) << 1;
+    next[len] = code;
+    if (code + count[len] > (1u << len)) {
+      return false;
+    }
+  }
+  for (uint32_t s = 0; s < h->nsyms; s++) {
+    uint32_t len = h->lens[s];
+    if (len) {
+      uint32_t c = next[len]++;
+      uint32_t rev = 0;
+      for (uint32_t i = 0; i < len; i++) {
+        rev = (rev << 1) | ((c >> i) & 1);
+      }
+      h->codes[s] = rev;
+    }
+  }
+  return true;
+}
+
+//
+// Builds the code lengths and codes of a HuffTable from the number of times
+// each symbol occurs, with no code longer than HUFF_MAX_BITS.
+//
+// h:       HuffTable to build.
+// freq:    Number of times each symbol occurs.
+// nsyms:   Number of symbols of the alphabet, at most HUFF_SYMS.
+// returns: Number of bits the symbols take when coded with the HuffTable.
+//
+uint64_t huff_build(HuffTable *h, const uint32_t *freq, uint32_t nsyms) {
+  h->nsyms = nsyms;
+  uint32_t limited[HUFF_SYMS];
+  const uint32_t *counts = freq;
+
+  // Flatten the counts until the deepest leaf is shallow enough, which
+  // costs next to nothing since only very rare symbols are that deep
+  while (huff_depths(h->lens, counts, nsyms) > HUFF_MAX_BITS) {
+    for (uint32_t s = 0; s < nsyms; s++) {
+      limited[s] = counts[s] ? (counts[s] >> 1) | 1 : 0;
+    }
+    counts = limited;
+  }
+  huff_codes(h);
+
+  uint64_t bits = 0;
+  for (uint32_t s = 0; s < nsyms; s++) {
+    bits += (uint64_t)freq[s] * h->lens[s];
+  }
+  return bits;
+}
+
+//
+// Builds the codes and the decoding table of a HuffTable from its code
+// lengths, as read from a stream.
+//
+// h:       HuffTable with nsyms and lens set.
+// returns: False if the lengths don't make up a prefix code, true otherwise.
+//
+bool huff_decode_table(HuffTable *h) {
+  if (!huff_codes(h)) {
+    return false;
+  }
+  // Every value of the next bits that starts with a code decodes to it,
+  // values no code starts are left at length zero
+  memset(h->lut, 0, sizeof(h->lut));
+  for (uint32_t s = 0; s < h->nsyms; s++) {
+    uint32_t len = h->lens[s];
+    if (len) {
+      uint16_t entry = (uint16_t)(s << 4 | len);
+      for (uint32_t v = h->codes[s]; v < (1u << HUFF_MAX_BITS);
+           v += 1u << len) {
+        h->lut[v] = entry;
+      }
+    }
+  }
+  return true;
+}
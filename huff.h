@@ -0,0 +1,58 @@
+#ifndef __HUFF_H__
+#define __HUFF_H__
+
+#include <inttypes.h>
+#include <stdbool.h>
+
+//
+// Largest number of symbols of a Huffman alphabet, and the longest code a
+// symbol may get. Codes are limited so that a single table lookup of
+// HUFF_MAX_BITS bits decodes any of them.
+//
+#define HUFF_SYMS 256
+#define HUFF_MAX_BITS 11
+
+//
+// Number of bits the length of each code is stored in.
+//
+#define HUFF_LEN_BITS 4
+
+//
+// Struct definition of a HuffTable, a canonical Huffman code.
+// Codes are packed starting from the LSB like the rest of a stream, so they
+// are stored bit reversed.
+//
+// nsyms:   Number of symbols of the alphabet.
+// lens:    Length of the code of each symbol, zero if it doesn't occur.
+// codes:   Code of each symbol, bit reversed.
+// lut:     Symbol and code length of every value of the next HUFF_MAX_BITS
+//          bits, as the symbol shifted up by 4 bits plus the length.
+//
+typedef struct HuffTable {
+  uint32_t nsyms;
+  uint8_t lens[HUFF_SYMS];
+  uint16_t codes[HUFF_SYMS];
+  uint16_t lut[1 << HUFF_MAX_BITS];
+} HuffTable;
+
+//
+// Builds the code lengths and codes of a HuffTable from the number of times
+// each symbol occurs, with no code longer than HUFF_MAX_BITS.
+//
+// h:       HuffTable to build.
+// freq:    Number of times each symbol occurs.
+// nsyms:   Number of symbols of the alphabet, at most HUFF_SYMS.
+// returns: Number of bits the symbols take when coded with the HuffTable.
+//
+uint64_t huff_build(HuffTable *h, const uint32_t *freq, uint32_t nsyms);
+
+//
+// Builds the codes and the decoding table of a HuffTable from its code
+// lengths, as read from a stream.
+//
+// h:       HuffTable with nsyms and lens set.
+// returns: False if the lengths don't make up a prefix code, true otherwise.
+//
+bool huff_decode_table(HuffTable *h);
+
+#endif
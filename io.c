@@ -1,33 +1,84 @@
 #include "io.h"
+#include "crc.h"
+#include "huff.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
 
-// Buffer to hold symbols
-static uint8_t buffer[BLOCK];
-static uint32_t byte_count = 0;
-
-// Counter to keep track of read symbols
-static int rbytes = 0;
+//
+// Stores 64 bits into 8 bytes of a buffer in little endian byte order.
+// The first bit of the stream is then the LSB of the first byte.
+//
+// buf:     Buffer to store the bits into.
+// bits:    Bits to store.
+// returns: Void.
+//
+static inline void store_le64(uint8_t *buf, uint64_t bits) {
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  bits = __builtin_bswap64(bits);
+#endif
+  memcpy(buf, &bits, sizeof(bits));
+  return;
+}
 
-// Buffer and counter to hold bits
-extern BitVector *bitbuf;
-static uint32_t bit_index = 0;
+//
+// Loads 64 bits from 8 bytes of a buffer in little endian byte order.
+// The LSB of the first byte is then the LSB of the loaded bits.
+//
+// buf:     Buffer to load the bits from.
+// returns: Loaded bits.
+//
+static inline uint64_t load_le64(uint8_t *buf) {
+  uint64_t bits = 0;
+  memcpy(&bits, buf, sizeof(bits));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  bits = __builtin_bswap64(bits);
+#endif
+  return bits;
+}
 
 //
 // Wrapper for the read() syscall.
 // Loops to read the specified number of bytes, or until input is exhausted.
+// If the infile is MEM_FD, the bytes are copied from the memory input.
 // Returns the number of bytes read.
 //
-// infile:  File descriptor of the input file to read from.
+// c:       Codec whose input file to read from.
 // buf:     Buffer to store read bytes into.
 // to_read: Number of bytes to read.
 // returns: Number of bytes read.
 //
-int read_bytes(int infile, uint8_t *buf, int to_read) {
+int read_bytes(Codec *c, uint8_t *buf, int to_read) {
+  // Condition to copy from the memory input, as much of it as is left
+  if (c->infile == MEM_FD) {
+    uint64_t left = c->in_len - c->in_pos;
+    int n = left < (uint64_t)to_read ? (int)left : to_read;
+    memcpy(buf, c->in_mem + c->in_pos, n);
+    c->in_pos += n;
+    return n;
+  }
+
+  // Time the reads for the CodecStats if there are any
+  Clock t;
+  if (c->stats) {
+    clock_now(&t);
+  }
+
+  // A piped infile is taken from the Ring its thread reads ahead into, so
+  // only the time the Codec waits for it is counted
+  if (c->in_ring && c->infile == c->in_ring->fd) {
+    int n = ring_read(c->in_ring, buf, to_read);
+    if (c->stats) {
+      clock_add(&c->stats->read, &t);
+    }
+    return n;
+  }
+
   // Counters to keep track of the total and read number of bytes
   int total_read = 0;
   int read_b = 0;
   // Loop to keep reading in bytes until a full block is read or until read()
   // returns 0
-  while ((read_b = read(infile, buf + total_read, to_read - total_read)) > 0
+  while ((read_b = read(c->infile, buf + total_read, to_read - total_read)) > 0
          && total_read < to_read) {
     if (read_b < 0) {
       printf("Error: Failed to read infile!\n");
@@ -35,20 +86,62 @@ int read_bytes(int infile, uint8_t *buf, int to_read) {
     }
     total_read += read_b;
   }
+  if (c->stats) {
+    clock_add(&c->stats->read, &t);
+  }
   return total_read;
 }
 
 //
 // Wrapper for the write() syscall.
 // Loops to write the specified number of bytes, or until nothing is written.
+// If the outfile is MEM_FD, the bytes are appended to the memory output.
 // Returns the number of bytes written.
 //
-// outfile:   File descriptor of the output file to write to.
+// c:         Codec whose output file to write to.
 // buf:       Buffer that stores the bytes to write out.
 // to_write:  Number of bytes to write.
 // returns:   Number of bytes written.
 //
-int write_bytes(int outfile, uint8_t *buf, int to_write) {
+int write_bytes(Codec *c, uint8_t *buf, int to_write) {
+  // Condition to append to the memory output, doubling it if it is full.
+  // Nothing is copied for no bytes, as the output may not be allocated yet
+  if (c->outfile == MEM_FD) {
+    if (to_write == 0) {
+      return 0;
+    }
+    if (c->out_len + to_write > c->out_cap) {
+      c->out_cap = c->out_cap ? c->out_cap : BLOCK;
+      while (c->out_len + to_write > c->out_cap) {
+        c->out_cap *= 2;
+      }
+      c->out_mem = (uint8_t *)realloc(c->out_mem, c->out_cap);
+      if (!c->out_mem) {
+        printf("Error: Failed to allocate memory for Codec output!\n");
+        exit(EXIT_FAILURE);
+      }
+    }
+    memcpy(c->out_mem + c->out_len, buf, to_write);
+    c->out_len += to_write;
+    return to_write;
+  }
+
+  // Time the writes for the CodecStats if there are any
+  Clock t;
+  if (c->stats) {
+    clock_now(&t);
+  }
+
+  // A piped outfile is put into the Ring its thread writes out from, so
+  // only the time the Codec waits for a free slot is counted
+  if (c->out_ring && c->outfile == c->out_ring->fd) {
+    ring_write(c->out_ring, buf, to_write);
+    if (c->stats) {
+      clock_add(&c->stats->write, &t);
+    }
+    return to_write;
+  }
+
   // Counters to keep track of the total number of bytes written and currently
   // written
   int wbytes = 0;
@@ -57,45 +150,174 @@ int write_bytes(int outfile, uint8_t *buf, int to_write) {
   // Loop to keep calling write() until the specific block is written or until
   // there is nothing else to write
   do {
-    wbytes = write(outfile, buf + total_written, to_write - total_written);
+    wbytes = write(c->outfile, buf + total_written, to_write - total_written);
     if (wbytes < 0) {
       printf("Error: Failed to write to outfile!\n");
       exit(EXIT_FAILURE);
     }
     total_written += wbytes;
   } while (wbytes > 0 && total_written != to_write);
+  if (c->stats) {
+    clock_add(&c->stats->write, &t);
+  }
   return total_written;
 }
 
 //
-// Reads in a FileHeader from the input file.
+// Maps the input file of a Codec into memory if it is a regular file.
+// The Codec then reads its input from the mapping, with MEM_FD as its infile.
+// Pipes, terminals and empty files are left to be read with read().
+// With CodecStats the pages are faulted in first, timed as reading.
+// Returns true if the input file was mapped, false otherwise.
+//
+// c:       Codec whose input file to map.
+// returns: True if the input file was mapped, false otherwise.
+//
+bool map_infile(Codec *c) {
+  struct stat st;
+  if (fstat(c->infile, &st) < 0 || !S_ISREG(st.st_mode) || st.st_size == 0) {
+    return false;
+  }
+  void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, c->infile, 0);
+  if (map == MAP_FAILED) {
+    return false;
+  }
+  // The whole file is walked once from start to end
+  madvise(map, st.st_size, MADV_SEQUENTIAL);
+
+  // With CodecStats the pages are faulted in up front, so the time the disk
+  // takes counts as reading rather than as whatever touches them first
+  if (c->stats) {
+    Clock t;
+    clock_now(&t);
+    madvise(map, st.st_size, MADV_WILLNEED);
+    long page = sysconf(_SC_PAGESIZE);
+    volatile uint8_t sink = 0;
+    for (off_t i = 0; i < st.st_size; i += page) {
+      sink ^= ((const uint8_t *)map)[i];
+    }
+    (void)sink;
+    clock_add(&c->stats->read, &t);
+  }
+
+  c->infile = MEM_FD;
+  c->in_mem = (const uint8_t *)map;
+  c->in_len = st.st_size;
+  c->in_pos = 0;
+  return true;
+}
+
+//
+// Unmaps the input file of a Codec that was mapped by map_infile().
+//
+// c:       Codec whose input file to unmap.
+// returns: Void.
+//
+void unmap_infile(Codec *c) {
+  munmap((void *)c->in_mem, c->in_len);
+  c->in_mem = NULL;
+  c->in_len = 0;
+  c->in_pos = 0;
+  return;
+}
+
+//
+// Starts a thread that reads the input file of a Codec ahead into a Ring,
+// so the Codec works on one part of the input while the next is read in.
+// The input file is read from the Ring from then on, so it must not be
+// seeked or read by anything else.
+//
+// c:       Codec whose input file to read ahead.
+// returns: Void.
+//
+void pipe_infile(Codec *c) {
+  c->in_ring = ring_create(c->infile, false);
+  return;
+}
+
+//
+// Starts a thread that writes out the output file of a Codec from a Ring,
+// so the Codec goes on while what it wrote before is still being written.
+// Writes to another file descriptor still go straight to it.
+//
+// c:       Codec whose output file to write behind.
+// returns: Void.
+//
+void pipe_outfile(Codec *c) {
+  c->out_ring = ring_create(c->outfile, true);
+  return;
+}
+
+//
+// Waits for the thread started by pipe_outfile() to write out everything in
+// its Ring, and stops the thread started by pipe_infile(). Either may not
+// have been started.
+//
+// c:       Codec whose input and output files to stop piping.
+// returns: Void.
+//
+void unpipe_files(Codec *c) {
+  // Time what is left to write out for the CodecStats if there are any
+  Clock t;
+  if (c->stats) {
+    clock_now(&t);
+  }
+  if (c->out_ring) {
+    ring_delete(c->out_ring);
+    c->out_ring = NULL;
+    if (c->stats) {
+      clock_add(&c->stats->write, &t);
+    }
+  }
+  if (c->in_ring) {
+    ring_delete(c->in_ring);
+    c->in_ring = NULL;
+  }
+  return;
+}
+
+//
+// Reads in a FileHeader from the input file, and with FLAG_SHARED the ID
+// of the shared dictionary after it into the Codec.
 // Endianness of header fields are swapped if byte order isn't little endian.
 //
-// infile:  File descriptor of input file to read header from.
+// c:       Codec whose input file to read from.
 // header:  Pointer to memory where the bytes of the read header should go.
 // returns: Void.
 //
-void read_header(int infile, FileHeader *header) {
+void read_header(Codec *c, FileHeader *header) {
   // Call the read() wrapper function casting the header struct to a uint8_T
-  read_bytes(infile, (uint8_t *)header, sizeof(FileHeader));
+  read_bytes(c, (uint8_t *)header, sizeof(FileHeader));
   // increase the total bits read to the size of the FileHeader *8
-  total_bits += sizeof(FileHeader) * 8;
+  c->total_bits += sizeof(FileHeader) * 8;
+  // The ID of the shared dictionary the stream needs follows the header
+  c->shared_id = 0;
+  if (header->policy & FLAG_SHARED) {
+    read_bytes(c, (uint8_t *)&c->shared_id, sizeof(uint32_t));
+    c->total_bits += sizeof(uint32_t) * 8;
+  }
   return;
 }
 
 //
-// Writes a FileHeader to the output file.
+// Writes a FileHeader to the output file, and with FLAG_SHARED the ID of
+// the shared dictionary of the Codec after it.
 // Endianness of header fields are swapped if byte order isn't little endian.
 //
-// outfile: File descriptor of output file to write header to.
+// c:       Codec whose output file to write to.
 // header:  Pointer to the header to write out.
 // returns: Void.
 //
-void write_header(int outfile, FileHeader *header) {
+void write_header(Codec *c, FileHeader *header) {
   // Call the write() wrapper function casting the header struct to a uint8_t
-  write_bytes(outfile, (uint8_t *)header, sizeof(FileHeader));
+  write_bytes(c, (uint8_t *)header, sizeof(FileHeader));
   // Increase the total bits written to the size of the FileHeader *8
-  total_bits += (sizeof(FileHeader) * 8);
+  c->total_bits += (sizeof(FileHeader) * 8);
+  // Followed by the ID of the shared dictionary of the Codec if any
+  if (header->policy & FLAG_SHARED) {
+    write_bytes(c, (uint8_t *)&c->shared_id, sizeof(uint32_t));
+    c->total_bits += sizeof(uint32_t) * 8;
+  }
   return;
 }
 
@@ -108,210 +330,675 @@ void write_header(int outfile, FileHeader *header) {
 // If less than a block is read, the end of the buffer is updated.
 // Returns true if there are symbols to be read, false otherwise.
 //
-// infile:  File descriptor of input file to read symbols from.
+// c:       Codec whose input file to read from.
 // sym:     Pointer to memory which stores the read symbol.
 // returns: True if there are symbols to be read, false otherwise.
 //
-bool read_sym(int infile, uint8_t *byte) {
-  // Condition to bytes from infile into the buffer
-  if (byte_count == 0) {
-    rbytes = read_bytes(infile, buffer, BLOCK);
-    total_syms += rbytes;
+bool read_sym(Codec *c, uint8_t *byte) {
+  // Condition to read bytes from infile into the buffer once every byte in
+  // the buffer has been processed
+  if (c->byte_count == c->rbytes) {
+    c->rbytes = read_bytes(c, c->buffer, BLOCK);
+    c->byte_count = 0;
+    c->total_syms += c->rbytes;
+    // The checksum takes in the whole block at once
+    if (c->checksum) {
+      c->crc = crc32c(c->crc, c->buffer, c->rbytes);
+    }
     // Condition to return false is nothing else to read
-    if (rbytes == 0) {
+    if (c->rbytes == 0) {
       return false;
     }
-    // Assign byte to the symbol in each index in the buffer
-    *byte = buffer[byte_count];
-    byte_count++;
-  } else {
-    // Assign byte to the symbol in each index in the buffer
-    *byte = buffer[byte_count];
-    byte_count++;
-    // Condition to reset the buffer counter when reached the end of buffer
-    if (byte_count == rbytes) {
-      byte_count = 0;
-    }
   }
+  // Assign byte to the symbol in each index in the buffer
+  *byte = c->buffer[c->byte_count];
+  c->byte_count++;
   return true;
 }
 
 //
-// Buffers a pair. A pair is comprised of a symbol and an index.
-// The bits of the symbol are buffered first, starting from the LSB.
-// The bits of the index are buffered next, also starting from the LSB.
-// bit_len bits of the index are buffered to provide a minimal representation.
+// Adds bits after the ones already in the accumulator of a Codec, storing
+// the accumulator into the bit buffer a whole word at a time.
 // The buffer is written out whenever it is filled.
 //
-// outfile: File descriptor of the output file to write to.
-// sym:     Symbol of the pair to buffer.
-// index:   Index of the pair to buffer.
-// bit_len: Number of bits of the index to buffer.
+// c:       Codec whose output file to write to.
+// bits:    Bits to add, starting from the LSB.
+// len:     Number of bits to add, at most 56.
 // returns: Void.
 //
-void buffer_pair(int outfile, uint16_t code, uint8_t sym, uint8_t bit_len) {
-  // Loop to iterate bit_len times
-  for (int bit = 0; bit < bit_len; bit++) {
-    // Condition to check if bit counter reaches end of buffer
-    // then write out buffer and reset bit counter
-    if (bit_index == BLOCK * 8) {
-      write_bytes(outfile, bitbuf->vector, BLOCK);
-      bit_index = 0;
-    }
-    // Condition to check if bit at a specific position is on
-    // then turn that bit on in the buffer
-    // else turn it off
-    if (code & (1 << bit)) {
-      bv_set_bit(bitbuf, bit_index);
-    } else {
-      bv_clr_bit(bitbuf, bit_index);
-    }
-    bit_index++;
-    total_bits++;
-  }
+static inline void buffer_bits(Codec *c, uint64_t bits, uint32_t len) {
+  c->bit_acc |= bits << c->acc_bits;
+  c->acc_bits += len;
+  c->total_bits += len;
 
-  // Loop to iterate 8 times for a byte
-  for (int bit = 0; bit < 8; bit++) {
+  // Condition to check if the accumulator is full, then store it as a
+  // word into the buffer and keep the bits that didn't fit
+  if (c->acc_bits >= 64) {
     // Condition to check if bit counter reaches end of buffer
     // then write out buffer and reset bit counter
-    if (bit_index == BLOCK * 8) {
-      write_bytes(outfile, bitbuf->vector, BLOCK);
-      bit_index = 0;
-    }
-    // Condition to check if bit at a specific position is on
-    // then turn that bit on in the buffer
-    // else turn it off
-    if (sym & (1 << bit)) {
-      bv_set_bit(bitbuf, bit_index);
-    } else {
-      bv_clr_bit(bitbuf, bit_index);
+    if (c->bit_index == BLOCK * 8) {
+      write_bytes(c, c->bitbuf->vector, BLOCK);
+      c->bit_index = 0;
     }
-    bit_index++;
-    total_bits++;
+    store_le64(c->bitbuf->vector + c->bit_index / 8, c->bit_acc);
+    c->bit_index += 64;
+    c->acc_bits -= 64;
+    c->bit_acc = bits >> (len - c->acc_bits);
   }
   return;
 }
 
+//
+// Buffers a pair. A pair is comprised of an index and a symbol.
+// The bits of the index are buffered first, starting from the LSB.
+// The bits of the symbol are buffered next, also starting from the LSB.
+// bit_len bits of the index are buffered to provide a minimal representation.
+// The pair is shifted into a 64-bit accumulator, which is stored into the
+// buffer a whole word at a time.
+// The buffer is written out whenever it is filled.
+//
+// c:       Codec whose output file to write to.
+// code:    Index of the pair to buffer.
+// sym:     Symbol of the pair to buffer.
+// bit_len: Number of bits of the index to buffer.
+// returns: Void.
+//
+void buffer_pair(Codec *c, uint32_t code, uint8_t sym, uint8_t bit_len) {
+  // Put the bit_len bits of the code and the 8 bits of the symbol together
+  uint64_t pair = (code & ((1u << bit_len) - 1)) | ((uint64_t)sym << bit_len);
+  buffer_bits(c, pair, bit_len + 8);
+  return;
+}
+
+//
+// Buffers a code on its own, as an LZW stream has no symbols after codes.
+// bit_len bits of the code are buffered, starting from the LSB.
+//
+// c:       Codec whose output file to write to.
+// code:    Code to buffer.
+// bit_len: Number of bits of the code to buffer.
+// returns: Void.
+//
+void buffer_code(Codec *c, uint32_t code, uint8_t bit_len) {
+  buffer_bits(c, code & ((1u << bit_len) - 1), bit_len);
+  return;
+}
+
 //
 // Writes out any remaining pairs of symbols and indexes to the output file.
 //
-// outfile: File descriptor of the output file to write to.
+// c:       Codec whose output file to write to.
 // returns: Void.
 //
-void flush_pairs(int outfile) {
+void flush_pairs(Codec *c) {
+  // Condition to check if the buffer is full and there are still bits in
+  // the accumulator, then write out the buffer first
+  if (c->bit_index == BLOCK * 8 && c->acc_bits > 0) {
+    write_bytes(c, c->bitbuf->vector, BLOCK);
+    c->bit_index = 0;
+  }
+
+  // Store the whole bytes left in the accumulator
+  while (c->acc_bits >= 8) {
+    c->bitbuf->vector[c->bit_index / 8] = c->bit_acc & 0xFF;
+    c->bit_acc >>= 8;
+    c->bit_index += 8;
+    c->acc_bits -= 8;
+  }
+  // Store the last bits in the accumulator while leaving the rest of the
+  // bits of that byte as they were
+  if (c->acc_bits > 0) {
+    uint8_t mask = (1 << c->acc_bits) - 1;
+    c->bitbuf->vector[c->bit_index / 8] &= ~mask;
+    c->bitbuf->vector[c->bit_index / 8] |= c->bit_acc & mask;
+    c->bit_index += c->acc_bits;
+  }
+  c->bit_acc = 0;
+  c->acc_bits = 0;
+
   // writes any remaining bytes left inside the buffer that is smaller than the block
-  write_bytes(outfile, bitbuf->vector, (bit_index / 8) + 1);
+  write_bytes(c, c->bitbuf->vector, (c->bit_index / 8) + 1);
   return;
 }
 
 //
-// "Reads" a pair (symbol and index) from the input file.
-// The "read" symbol is placed in the pointer to sym (pass by reference).
+// Loads bits from the bit buffer of a Codec into its 64-bit accumulator
+// until it holds at least len bits. Bits are loaded a word at a time, and
+// once all bytes of the buffer have been loaded, another block is read.
+//
+// c:       Codec whose input file to read from.
+// len:     Number of bits the accumulator has to hold, at most 56.
+// returns: True if the accumulator holds len bits, false if the input ended.
+//
+static inline bool load_bits(Codec *c, uint32_t len) {
+  // Loop until the accumulator holds all the bits
+  while (c->acc_bits < len) {
+    uint32_t byte = c->bit_index / 8;
+    if (byte + 8 <= c->rbytes) {
+      // Load as many whole bytes as fit in the accumulator with one word,
+      // the bits of the word past those bytes are the same bits the next
+      // load puts there
+      c->bit_acc |= load_le64(c->bitbuf->vector + byte) << c->acc_bits;
+      uint32_t loaded = (63 - c->acc_bits) / 8;
+      c->bit_index += loaded * 8;
+      c->acc_bits += loaded * 8;
+    } else if (byte < c->rbytes) {
+      // Load the last few bytes of the buffer one at a time
+      c->bit_acc |= (uint64_t)c->bitbuf->vector[byte] << c->acc_bits;
+      c->bit_index += 8;
+      c->acc_bits += 8;
+    } else {
+      // All bytes of the buffer are loaded, so read a new block and reset
+      // the bit counter
+      c->rbytes = read_bytes(c, c->bitbuf->vector, BLOCK);
+      c->bit_index = 0;
+      // Condition to check if the amount of bytes read is 0, if so then
+      // return false
+      if (c->rbytes == 0) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+//
+// "Reads" a pair (index and symbol) from the input file.
 // The "read" index is placed in the pointer to index (pass by reference).
+// The "read" symbol is placed in the pointer to sym (pass by reference).
 // In reality, a block of pairs is read into a buffer.
-// An index keeps track of the current bit in the buffer.
-// Once all bits have been processed, another block is read.
-// The first 8 bits of the pair constitute the symbol, starting from the LSB.
-// The next bit_len bits constitutes the index, starting from the the LSB.
+// Bits are loaded from the buffer into a 64-bit accumulator a word at a time.
+// Once all bytes of the buffer have been loaded, another block is read.
+// The first bit_len bits of the pair constitute the index, starting from
+// the LSB. The next 8 bits constitute the symbol, starting from the LSB.
 // Returns true if there are pairs left to read in the buffer, else false.
 // There are pairs left to read if the read index is not STOP_INDEX.
 //
-// infile:  File descriptor of the input file to read from.
+// c:       Codec whose input file to read from.
+// code:    Pointer to memory which stores the read index.
 // sym:     Pointer to memory which stores the read symbol.
-// index:   Pointer to memory which stores the read index.
 // bit_len: Length in bits of the index to read.
 // returns: True if there are pairs left to read, false otherwise.
 //
-bool read_pair(int infile, uint16_t *code, uint8_t *sym, uint8_t bit_len) {
-  (*code) = 0;
-  (*sym) = 0;
-  // Loop to iterate bit_len times
-  for (int bit = 0; bit < bit_len; bit++) {
-    // Condition to check if the bit counter is at the end of the buffer or
-    // the buffer has nothin in it, then read a new block and reset the bit
-    // counter
-    if (bit_index == BLOCK * 8 || bit_index == 0) {
-      rbytes = read_bytes(infile, bitbuf->vector, BLOCK);
-      bit_index = 0;
-      // Condition to check if the amount of bytes read is 0, if so then
-      // return false
-      if (rbytes == 0) {
-        return false;
-      }
+bool read_pair(Codec *c, uint32_t *code, uint8_t *sym, uint8_t bit_len) {
+  uint32_t pair_len = bit_len + 8;
+  if (!load_bits(c, pair_len)) {
+    return false;
+  }
+
+  // Take the code and then the symbol off the bottom of the accumulator
+  (*code) = c->bit_acc & ((1u << bit_len) - 1);
+  (*sym) = (c->bit_acc >> bit_len) & 0xFF;
+  c->bit_acc >>= pair_len;
+  c->acc_bits -= pair_len;
+  c->total_bits += pair_len;
+
+  //Condition if the code received is the STOP_CODE, then return false
+  if ((*code) == STOP_CODE) {
+    return false;
+  }
+  return true;
+}
+
+//
+// "Reads" a code of an LZW stream, which has no symbols after codes.
+// The first bit_len bits constitute the code, starting from the LSB.
+//
+// c:       Codec whose input file to read from.
+// code:    Pointer to memory which stores the read code.
+// bit_len: Length in bits of the code to read.
+// returns: True if there are codes left to read, false once the STOP_CODE
+//          is read or the input ended.
+//
+bool read_code(Codec *c, uint32_t *code, uint8_t bit_len) {
+  if (!load_bits(c, bit_len)) {
+    return false;
+  }
+  (*code) = c->bit_acc & ((1u << bit_len) - 1);
+  c->bit_acc >>= bit_len;
+  c->acc_bits -= bit_len;
+  c->total_bits += bit_len;
+  return (*code) != STOP_CODE;
+}
+
+//
+// Returns the number of bits read_pair() can take without reaching past the
+// end of the input. Only a memory input has a known end, so the count only
+// includes the input itself when the infile is MEM_FD.
+//
+// c:       Codec that reads pairs.
+// returns: Number of bits left to read.
+//
+uint64_t pair_bits_left(Codec *c) {
+  uint64_t bits = c->acc_bits + ((uint64_t)c->rbytes * 8 - c->bit_index);
+  if (c->infile == MEM_FD) {
+    bits += (c->in_len - c->in_pos) * 8;
+  }
+  return bits;
+}
+
+//
+// Finds the bucket a code is Huffman coded as in a block, made of the bit
+// length of the code and the BUCKET_BITS bits below its top bit. Codes with
+// no bits after those are a bucket each.
+//
+// code:    Code to find the bucket of.
+// returns: Bucket of the code.
+//
+static inline uint32_t code_bucket(uint32_t code) {
+  if (code < (2u << BUCKET_BITS)) {
+    return code;
+  }
+  uint32_t n = bit_length(code);
+  uint32_t top = code >> (n - 1 - BUCKET_BITS);
+  return ((n - BUCKET_BITS - 1) << BUCKET_BITS) + top;
+}
+
+//
+// Returns the number of bits of a code that follow its bucket.
+//
+// bucket:  Bucket of the code.
+// returns: Number of bits after the bucket.
+//
+static inline uint32_t bucket_extra(uint32_t bucket) {
+  return bucket < (1u << BUCKET_BITS) ? 0 : (bucket >> BUCKET_BITS) - 1;
+}
+
+//
+// Returns the smallest code of a bucket, which the bits that follow the
+// bucket are added to.
+//
+// bucket:  Bucket of the code.
+// returns: Smallest code of the bucket.
+//
+static inline uint32_t bucket_base(uint32_t bucket) {
+  if (bucket < (1u << BUCKET_BITS)) {
+    return bucket;
+  }
+  uint32_t top = (1u << BUCKET_BITS) | (bucket & ((1u << BUCKET_BITS) - 1));
+  return top << bucket_extra(bucket);
+}
+
+//
+// Takes the next bits of a block body that starts at the first byte of a
+// buffer, at least 57 of them. The buffer is big enough for every load a
+// block can make.
+//
+// buf:     Buffer holding the body.
+// pos:     Position of the bit to start from.
+// returns: Bits from the position on, starting from the LSB.
+//
+static inline uint64_t peek_bits(uint8_t *buf, uint64_t pos) {
+  return load_le64(buf + pos / 8) >> (pos & 7);
+}
+
+//
+// Rounds a number of bits of a block body up to a whole number of bytes.
+//
+// bits:    Number of bits from the start of the body.
+// returns: Number of bits up to the next whole byte.
+//
+static inline uint64_t byte_align(uint64_t bits) {
+  return (bits + 7) & ~7ull;
+}
+
+//
+// Buffers a block of pairs of an entropy coded stream, coded whichever way
+// takes fewer bits. The codes of all pairs come first, and the symbols of
+// all pairs follow from the next whole byte of the body on. A block with no
+// pairs ends the stream.
+//
+// c:       Codec whose output file to write to.
+// codes:   Codes of the pairs, the codes of a reset are pairs of their own.
+// syms:    Symbols of the pairs, unused by LZW.
+// npairs:  Number of pairs in the block, at most BLOCK_PAIRS.
+// returns: Void.
+//
+void buffer_block(Codec *c, uint32_t *codes, uint8_t *syms, uint32_t npairs) {
+  if (npairs == 0) {
+    buffer_bits(c, 0, BLOCK_HEADER_BITS);
+    return;
+  }
+
+  // Count the buckets of the codes and the symbols to size both codings
+  uint32_t code_freq[CODE_BUCKETS] = { 0 };
+  uint32_t sym_freq[HUFF_SYMS] = { 0 };
+  uint32_t max = 0;
+  uint64_t extra = 0;
+  for (uint32_t i = 0; i < npairs; i++) {
+    uint32_t bucket = code_bucket(codes[i]);
+    code_freq[bucket]++;
+    extra += bucket_extra(bucket);
+    max |= codes[i];
+  }
+  if (!c->lzw) {
+    for (uint32_t i = 0; i < npairs; i++) {
+      sym_freq[syms[i]]++;
     }
+  }
+  uint8_t width = bit_length(max);
+  uint64_t raw_codes = 5 + (uint64_t)npairs * width;
+  uint64_t raw_syms = c->lzw ? 0 : (uint64_t)npairs * 8;
+
+  HuffTable code_table, sym_table;
+  uint64_t huff_codes = CODE_BUCKETS * HUFF_LEN_BITS + extra
+                        + huff_build(&code_table, code_freq, CODE_BUCKETS);
+  uint64_t huff_syms = 0;
+  if (!c->lzw) {
+    huff_codes += HUFF_SYMS * HUFF_LEN_BITS;
+    huff_syms = huff_build(&sym_table, sym_freq, HUFF_SYMS);
+  }
 
-    // Condition to check if the bit within the bit buffer at a specifc position
-    // is on, if so add that bit value to the code
-    if (bv_get_bit(bitbuf, bit_index)) {
-      (*code) += 1 << bit;
+  // The symbols start at a whole byte of the body, LZW has none
+  uint64_t raw = c->lzw ? raw_codes : byte_align(raw_codes) + raw_syms;
+  uint64_t huff = c->lzw ? huff_codes : byte_align(huff_codes) + huff_syms;
+  uint64_t mode = raw <= huff ? BLOCK_RAW : BLOCK_HUFF;
+  uint64_t body = mode == BLOCK_RAW ? raw : huff;
+  buffer_bits(c, npairs | mode << 16 | body << 17, BLOCK_HEADER_BITS);
+  uint64_t start = c->total_bits;
+
+  if (mode == BLOCK_RAW) {
+    // Two codes are packed at a time, which fit in the accumulator
+    buffer_bits(c, width, 5);
+    uint32_t i = 0;
+    for (; i + 1 < npairs; i += 2) {
+      buffer_bits(c, codes[i] | (uint64_t)codes[i + 1] << width, 2 * width);
     }
-    bit_index++;
-    total_bits++;
-  }
-
-  // Loop to iterate 8 times for a byte
-  for (int bit = 0; bit < 8; bit++) {
-    // Condition to check if the bit counter is at the end of the buffer or
-    // the buffer has nothin in it, then read a new block and reset the bit
-    // counter
-    if (bit_index == BLOCK * 8 || bit_index == 0) {
-      rbytes = read_bytes(infile, bitbuf->vector, BLOCK);
-      bit_index = 0;
-      // Condition to check if the amount of bytes read is 0, if so then
-      // return false
-      if (rbytes == 0) {
-        return false;
+    if (i < npairs) {
+      buffer_bits(c, codes[i], width);
+    }
+  } else {
+    for (uint32_t b = 0; b < CODE_BUCKETS; b++) {
+      buffer_bits(c, code_table.lens[b], HUFF_LEN_BITS);
+    }
+    if (!c->lzw) {
+      for (uint32_t s = 0; s < HUFF_SYMS; s++) {
+        buffer_bits(c, sym_table.lens[s], HUFF_LEN_BITS);
       }
     }
-    // Condition to check if the bit within the bit buffer at a specifc position
-    // is on, if so add that bit value to the code
-    if (bv_get_bit(bitbuf, bit_index)) {
-      (*sym) += 1 << bit;
+    // A code is its bucket followed by the rest of its bits
+    for (uint32_t i = 0; i < npairs; i++) {
+      uint32_t bucket = code_bucket(codes[i]);
+      uint32_t x = bucket_extra(bucket);
+      uint64_t rest = codes[i] & ((1u << x) - 1);
+      buffer_bits(c, code_table.codes[bucket]
+                     | rest << code_table.lens[bucket],
+          code_table.lens[bucket] + x);
     }
-    bit_index++;
-    total_bits++;
   }
-  //Condition if the code received is the STOP_CODE, then return false
-  if ((*code) == STOP_CODE) {
+  if (c->lzw) {
+    return;
+  }
+
+  buffer_bits(c, 0, byte_align(c->total_bits - start)
+                    - (c->total_bits - start));
+  if (mode == BLOCK_RAW) {
+    for (uint32_t i = 0; i < npairs; i++) {
+      buffer_bits(c, syms[i], 8);
+    }
+  } else {
+    for (uint32_t i = 0; i < npairs; i++) {
+      buffer_bits(c, sym_table.codes[syms[i]], sym_table.lens[syms[i]]);
+    }
+  }
+  return;
+}
+
+//
+// Reads the code lengths of a HuffTable from a block body and builds its
+// decoding table.
+//
+// h:       HuffTable to build.
+// nsyms:   Number of symbols of the alphabet.
+// buf:     Buffer holding the body.
+// pos:     Position of the first code length, moved past the last one.
+// returns: False if the code lengths are invalid, true otherwise.
+//
+static bool read_table(HuffTable *h, uint32_t nsyms, uint8_t *buf,
+    uint64_t *pos) {
+  h->nsyms = nsyms;
+  for (uint32_t s = 0; s < nsyms; s++) {
+    h->lens[s] = peek_bits(buf, *pos) & ((1u << HUFF_LEN_BITS) - 1);
+    *pos += HUFF_LEN_BITS;
+    if (h->lens[s] > HUFF_MAX_BITS) {
+      return false;
+    }
+  }
+  return huff_decode_table(h);
+}
+
+//
+// "Reads" a block of pairs of an entropy coded stream. The body of the block
+// is copied into the block buffer of the Codec, and then the codes and the
+// symbols are decoded from there, each section in a loop of its own. Raw
+// codes are unpacked two at a time and raw symbols copied as they are, and
+// a Huffman code is decoded with a single table lookup.
+//
+// c:       Codec whose input file to read from.
+// codes:   Array of BLOCK_PAIRS codes to store the codes of the block into.
+// syms:    Array of BLOCK_PAIRS symbols to store the symbols into.
+// npairs:  Pointer to memory which stores the number of pairs read.
+// returns: DECODE_MORE if a block was read, DECODE_DONE at the end of the
+//          stream and DECODE_CORRUPT if the block is invalid.
+//
+int read_block(Codec *c, uint32_t *codes, uint8_t *syms, uint32_t *npairs) {
+  *npairs = 0;
+  if (!load_bits(c, BLOCK_HEADER_BITS)) {
+    return DECODE_DONE;
+  }
+  uint64_t header = c->bit_acc & ((1ull << BLOCK_HEADER_BITS) - 1);
+  c->bit_acc >>= BLOCK_HEADER_BITS;
+  c->acc_bits -= BLOCK_HEADER_BITS;
+  c->total_bits += BLOCK_HEADER_BITS;
+  uint32_t n = header & 0xFFFF;
+  uint32_t mode = (header >> 16) & 1;
+  uint64_t body = header >> 17;
+  if (n == 0) {
+    return DECODE_DONE;
+  }
+  if (n > BLOCK_PAIRS || body > (BLOCK_BYTES - 8) * 8) {
+    return DECODE_CORRUPT;
+  }
+
+  // Copy the body out of the accumulator 7 bytes at a time, so it can be
+  // decoded without checking for the end of the input
+  uint8_t *buf = c->block_buf;
+  for (uint64_t done = 0; done < body; done += 56) {
+    uint32_t len = body - done < 56 ? body - done : 56;
+    if (!load_bits(c, len)) {
+      return DECODE_CORRUPT;
+    }
+    store_le64(buf + done / 8, c->bit_acc & ((1ull << len) - 1));
+    c->bit_acc >>= len;
+    c->acc_bits -= len;
+  }
+  c->total_bits += body;
+
+  uint64_t pos = 0;
+  uint32_t lut_mask = (1u << HUFF_MAX_BITS) - 1;
+  HuffTable code_table, sym_table;
+  if (mode == BLOCK_RAW) {
+    uint32_t width = peek_bits(buf, pos) & 31;
+    pos += 5;
+    if (width > MAX_WIDTH) {
+      return DECODE_CORRUPT;
+    }
+    // Two codes fit in the 57 bits of every load
+    uint32_t mask = (1u << width) - 1;
+    uint32_t i = 0;
+    for (; i + 1 < n; i += 2) {
+      uint64_t bits = peek_bits(buf, pos);
+      codes[i] = bits & mask;
+      codes[i + 1] = (bits >> width) & mask;
+      pos += 2 * width;
+    }
+    if (i < n) {
+      codes[i] = peek_bits(buf, pos) & mask;
+      pos += width;
+    }
+  } else {
+    if (!read_table(&code_table, CODE_BUCKETS, buf, &pos)
+        || (!c->lzw && !read_table(&sym_table, HUFF_SYMS, buf, &pos))) {
+      return DECODE_CORRUPT;
+    }
+    for (uint32_t i = 0; i < n; i++) {
+      uint64_t bits = peek_bits(buf, pos);
+      uint16_t entry = code_table.lut[bits & lut_mask];
+      uint32_t bucket = entry >> 4;
+      uint32_t len = entry & 15;
+      uint32_t x = bucket_extra(bucket);
+      codes[i] = bucket_base(bucket) | ((bits >> len) & ((1u << x) - 1));
+      pos += len + x;
+    }
+  }
+
+  if (!c->lzw) {
+    pos = byte_align(pos);
+    if (mode == BLOCK_RAW) {
+      memcpy(syms, buf + pos / 8, n);
+    } else {
+      // Four symbols fit in the 57 bits of every load
+      uint32_t i = 0;
+      for (; i + 3 < n; i += 4) {
+        uint64_t bits = peek_bits(buf, pos);
+        for (uint32_t k = 0; k < 4; k++) {
+          uint16_t entry = sym_table.lut[bits & lut_mask];
+          syms[i + k] = entry >> 4;
+          bits >>= entry & 15;
+          pos += entry & 15;
+        }
+      }
+      for (; i < n; i++) {
+        uint16_t entry = sym_table.lut[peek_bits(buf, pos) & lut_mask];
+        syms[i] = entry >> 4;
+        pos += entry & 15;
+      }
+    }
+  }
+  *npairs = n;
+  return DECODE_MORE;
+}
+
+//
+// Returns whether read_block() can take a whole block without reaching
+// past the end of the input, counted the same way as pair_bits_left().
+// With a checksum, the block has to be followed by at least as many bits
+// as the checksum takes, so the last block is only read with it.
+//
+// c:       Codec that reads blocks.
+// returns: True if the next block is buffered, false otherwise.
+//
+bool block_buffered(Codec *c) {
+  uint64_t left = pair_bits_left(c);
+  if (left < BLOCK_HEADER_BITS || !load_bits(c, BLOCK_HEADER_BITS)) {
     return false;
   }
-  return true;
+  uint64_t body = (c->bit_acc >> 17) & ((1u << 24) - 1);
+  uint64_t trailer = c->checksum ? CHECKSUM_BITS : 0;
+  return left >= BLOCK_HEADER_BITS + body + trailer;
+}
+
+//
+// Buffers the CRC32C of the input of an encoder, which follows the end of
+// the stream.
+//
+// c:       Codec whose output file to write to.
+// returns: Void.
+//
+void buffer_checksum(Codec *c) {
+  buffer_bits(c, c->crc, CHECKSUM_BITS);
+  return;
+}
+
+//
+// "Reads" the CRC32C that follows the end of a stream, and checks it against
+// the CRC32C of the output of a decoder. The output has to be flushed first.
+//
+// c:       Codec whose input file to read from.
+// returns: True if the checksums match, false if they don't or the input
+//          ended.
+//
+bool read_checksum(Codec *c) {
+  if (!load_bits(c, CHECKSUM_BITS)) {
+    return false;
+  }
+  uint32_t crc = c->bit_acc & 0xFFFFFFFF;
+  c->bit_acc >>= CHECKSUM_BITS;
+  c->acc_bits -= CHECKSUM_BITS;
+  c->total_bits += CHECKSUM_BITS;
+  return crc == c->crc;
+}
+
+//
+// Buffers a single symbol, the buffer is written out once it fills.
+//
+// c:       Codec whose output file to write to.
+// sym:     Symbol to buffer.
+// returns: Void.
+//
+void buffer_sym(Codec *c, uint8_t sym) {
+  c->buffer[c->byte_count++] = sym;
+  if (c->byte_count == BLOCK) {
+    if (c->checksum) {
+      c->crc = crc32c(c->crc, c->buffer, BLOCK);
+    }
+    write_bytes(c, c->buffer, BLOCK);
+    c->byte_count = 0;
+  }
+  c->total_syms++;
+  return;
 }
 
 //
 // Buffers a Word, or more specifically, the symbols of a Word.
-// Each symbol of the Word is placed into a buffer.
+// The symbols of the Word are copied from the history of the WordTable of
+// the Codec into a buffer, as many at a time as fit.
 // The buffer is written out when it is filled.
 //
-// outfile: File descriptor of the output file to write to.
+// c:       Codec whose output file to write to.
 // w:       Word to buffer.
 // returns: Void.
 //
-void buffer_word(int outfile, Word *w) {
-  // Loop through all the elements in the words symbols array
-  for (int i = 0; i < w->len; i++) {
-    // Add every symbol in the word to the buffer
-    buffer[byte_count] = w->syms[i];
-    byte_count++;
-    total_syms++;
+void buffer_word(Codec *c, Word *w) {
+  uint8_t *syms = word_syms(c->wt, w);
+  uint32_t done = 0;
+  // Loop until all the symbols of the word are in the buffer
+  while (done < w->len) {
+    // Copy as many symbols as there is room for in the buffer
+    uint32_t n = w->len - done;
+    if (n > BLOCK - c->byte_count) {
+      n = BLOCK - c->byte_count;
+    }
+    memcpy(c->buffer + c->byte_count, syms + done, n);
+    c->byte_count += n;
+    done += n;
     // Condition to check if the byte counter is at the end of the buffer
     // if so then write out the buffer to the outfile and reset the byte counter
-    if (byte_count == BLOCK) {
-      write_bytes(outfile, buffer, BLOCK);
-      byte_count = 0;
+    // The checksum takes in the whole buffer at once as it is written out
+    if (c->byte_count == BLOCK) {
+      if (c->checksum) {
+        c->crc = crc32c(c->crc, c->buffer, BLOCK);
+      }
+      write_bytes(c, c->buffer, BLOCK);
+      c->byte_count = 0;
     }
   }
+  c->total_syms += w->len;
   return;
 }
 
 //
 // Writes out any remaining symbols in the buffer.
 //
-// outfile: File descriptor of the output file to write to.
+// c:       Codec whose output file to write to.
 // returns: Void.
 //
-void flush_words(int outfile) {
+void flush_words(Codec *c) {
   // Writes out any remainder bytes smaller than the block thats still in the buffer
-  write_bytes(outfile, buffer, byte_count);
+  if (c->checksum) {
+    c->crc = crc32c(c->crc, c->buffer, c->byte_count);
+  }
+  write_bytes(c, c->buffer, c->byte_count);
+  c->byte_count = 0;
   return;
 }
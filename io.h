@@ -1,75 +1,178 @@
 #ifndef __IO_H__
 #define __IO_H__
 
-#include "bv.h"
-#include "word.h"
+#include "codec.h"
 #include <fcntl.h>
 #include <inttypes.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 
 #define MAGIC 0x8badbeef
-#define BLOCK 4096
+#define FRAME_MAGIC 0x8badf00d
+#define LZW_MAGIC 0x8badcafe
+#define LZW_FRAME_MAGIC 0x8badface
+#define ARCHIVE_MAGIC 0x8badbabe
+#define LZW_ARCHIVE_MAGIC 0x8badbead
 
-extern uint64_t total_syms;
-extern uint64_t total_bits;
+//
+// The reset policy takes up the low bits of the policy byte of a FileHeader
+// and flags for how the stream is written the high bits. FLAG_ENTROPY marks
+// a stream of entropy coded blocks of pairs, and FLAG_CHECKSUM a stream
+// with a CRC32C of the uncompressed bytes, CHECKSUM_BITS bits long, right
+// after its STOP_CODE or empty block. Every frame of a framed stream has a
+// checksum of its own. FLAG_INDEX marks a framed stream that ends with an
+// index of its frames. FLAG_SHARED marks a stream compressed with a shared
+// dictionary, whose ID follows the FileHeader as 32 bits.
+//
+#define POLICY_MASK 0x0F
+#define FLAG_ENTROPY 0x10
+#define FLAG_CHECKSUM 0x20
+#define FLAG_INDEX 0x40
+#define FLAG_SHARED 0x80
+#define CHECKSUM_BITS 32
+
+//
+// Layout of a block of an entropy coded stream. The header of a block is
+// the number of pairs in it, 16 bits, the way the pairs are coded, 1 bit,
+// and the number of bits of the body after the header, 24 bits. A block
+// with no pairs ends the stream. The body holds all codes of the block in
+// one section and all symbols in another, which starts at a whole byte of
+// the body. BLOCK_RAW packs the codes into as many bits as the largest code
+// of the block takes, 5 bits, followed by the codes and then the symbols as
+// bytes. BLOCK_HUFF has the code lengths of the code buckets and then of the
+// symbols, HUFF_LEN_BITS each, followed by the Huffman codes of the codes
+// and then of the symbols. A code is coded as its bucket, the bit length of
+// the code and the BUCKET_BITS bits below its top bit, followed by the rest
+// of its bits. An LZW stream has no symbols, or code lengths of them.
+//
+#define BLOCK_RAW 0
+#define BLOCK_HUFF 1
+#define BLOCK_HEADER_BITS 41
+#define BUCKET_BITS 2
+#define CODE_BUCKETS ((MAX_WIDTH - BUCKET_BITS + 1) << BUCKET_BITS)
 
 //
 // Struct definition of a FileHeader.
 //
 // magic:       Magic number indicating a file compressed by this program.
+//              MAGIC is a single stream, FRAME_MAGIC is a sequence of frames.
+//              ARCHIVE_MAGIC is a sequence of the members of a batch.
+//              LZW_MAGIC, LZW_FRAME_MAGIC and LZW_ARCHIVE_MAGIC are the
+//              same for LZW streams.
 // protection:  Protection/permissions of the original, uncompressed file.
+// width:       Number of bits of the largest code, zero for DEFAULT_WIDTH.
+//              Streams from before the width was chosen have zero here.
+// policy:      What happens once the dictionary is full, one of RESET_FULL,
+//              RESET_FREEZE or RESET_ADAPTIVE, along with the flags above.
 //
 typedef struct FileHeader {
   uint32_t magic;
   uint16_t protection;
+  uint8_t width;
+  uint8_t policy;
 } FileHeader;
 
 //
 // Wrapper for the read() syscall.
 // Loops to read the specified number of bytes, or until input is exhausted.
+// If the infile is MEM_FD, the bytes are copied from the memory input.
 // Returns the number of bytes read.
 //
-// infile:  File descriptor of the input file to read from.
+// c:       Codec whose input file to read from.
 // buf:     Buffer to store read bytes into.
 // to_read: Number of bytes to read.
 // returns: Number of bytes read.
 //
-int read_bytes(int infile, uint8_t *buf, int to_read);
+int read_bytes(Codec *c, uint8_t *buf, int to_read);
 
 //
 // Wrapper for the write() syscall.
 // Loops to write the specified number of bytes, or until nothing is written.
+// If the outfile is MEM_FD, the bytes are appended to the memory output.
 // Returns the number of bytes written.
 //
-// outfile:   File descriptor of the output file to write to.
+// c:         Codec whose output file to write to.
 // buf:       Buffer that stores the bytes to write out.
 // to_write:  Number of bytes to write.
 // returns:   Number of bytes written.
 //
-int write_bytes(int outfile, uint8_t *buf, int to_write);
+int write_bytes(Codec *c, uint8_t *buf, int to_write);
+
+//
+// Maps the input file of a Codec into memory if it is a regular file.
+// The Codec then reads its input from the mapping, with MEM_FD as its infile.
+// Pipes, terminals and empty files are left to be read with read().
+// With CodecStats the pages are faulted in first, timed as reading.
+// Returns true if the input file was mapped, false otherwise.
+//
+// c:       Codec whose input file to map.
+// returns: True if the input file was mapped, false otherwise.
+//
+bool map_infile(Codec *c);
+
+//
+// Unmaps the input file of a Codec that was mapped by map_infile().
+//
+// c:       Codec whose input file to unmap.
+// returns: Void.
+//
+void unmap_infile(Codec *c);
 
 //
-// Reads in a FileHeader from the input file.
+// Starts a thread that reads the input file of a Codec ahead into a Ring,
+// so the Codec works on one part of the input while the next is read in.
+// The input file is read from the Ring from then on, so it must not be
+// seeked or read by anything else.
+//
+// c:       Codec whose input file to read ahead.
+// returns: Void.
+//
+void pipe_infile(Codec *c);
+
+//
+// Starts a thread that writes out the output file of a Codec from a Ring,
+// so the Codec goes on while what it wrote before is still being written.
+// Writes to another file descriptor still go straight to it.
+//
+// c:       Codec whose output file to write behind.
+// returns: Void.
+//
+void pipe_outfile(Codec *c);
+
+//
+// Waits for the thread started by pipe_outfile() to write out everything in
+// its Ring, and stops the thread started by pipe_infile(). Either may not
+// have been started.
+//
+// c:       Codec whose input and output files to stop piping.
+// returns: Void.
+//
+void unpipe_files(Codec *c);
+
+//
+// Reads in a FileHeader from the input file, and with FLAG_SHARED the ID
+// of the shared dictionary after it into the Codec.
 // Endianness of header fields are swapped if byte order isn't little endian.
 //
-// infile:  File descriptor of input file to read header from.
+// c:       Codec whose input file to read from.
 // header:  Pointer to memory where the bytes of the read header should go.
 // returns: Void.
 //
-void read_header(int infile, FileHeader *header);
+void read_header(Codec *c, FileHeader *header);
 
 //
-// Writes a FileHeader to the output file.
+// Writes a FileHeader to the output file, and with FLAG_SHARED the ID of
+// the shared dictionary of the Codec after it.
 // Endianness of header fields are swapped if byte order isn't little endian.
 //
-// outfile: File descriptor of output file to write header to.
+// c:       Codec whose output file to write to.
 // header:  Pointer to the header to write out.
 // returns: Void.
 //
-void write_header(int outfile, FileHeader *header);
+void write_header(Codec *c, FileHeader *header);
 
 //
 // "Reads" a symbol from the input file.
@@ -80,72 +183,175 @@ void write_header(int outfile, FileHeader *header);
 // If less than a block is read, the end of the buffer is updated.
 // Returns true if there are symbols to be read, false otherwise.
 //
-// infile:  File descriptor of input file to read symbols from.
+// c:       Codec whose input file to read from.
 // sym:     Pointer to memory which stores the read symbol.
 // returns: True if there are symbols to be read, false otherwise.
 //
-bool read_sym(int infile, uint8_t *byte);
+bool read_sym(Codec *c, uint8_t *byte);
 
 //
-// Buffers a pair. A pair is comprised of a symbol and an index.
-// The bits of the symbol are buffered first, starting from the LSB.
-// The bits of the index are buffered next, also starting from the LSB.
+// Buffers a pair. A pair is comprised of an index and a symbol.
+// The bits of the index are buffered first, starting from the LSB.
+// The bits of the symbol are buffered next, also starting from the LSB.
 // bit_len bits of the index are buffered to provide a minimal representation.
+// The pair is shifted into a 64-bit accumulator, which is stored into the
+// buffer a whole word at a time.
 // The buffer is written out whenever it is filled.
 //
-// outfile: File descriptor of the output file to write to.
+// c:       Codec whose output file to write to.
+// code:    Index of the pair to buffer.
 // sym:     Symbol of the pair to buffer.
-// index:   Index of the pair to buffer.
 // bit_len: Number of bits of the index to buffer.
 // returns: Void.
 //
-void buffer_pair(int outfile, uint16_t code, uint8_t sym, uint8_t bit_len);
+void buffer_pair(Codec *c, uint32_t code, uint8_t sym, uint8_t bit_len);
+
+//
+// Buffers a code on its own, as an LZW stream has no symbols after codes.
+// bit_len bits of the code are buffered, starting from the LSB.
+//
+// c:       Codec whose output file to write to.
+// code:    Code to buffer.
+// bit_len: Number of bits of the code to buffer.
+// returns: Void.
+//
+void buffer_code(Codec *c, uint32_t code, uint8_t bit_len);
 
 //
 // Writes out any remaining pairs of symbols and indexes to the output file.
 //
-// outfile: File descriptor of the output file to write to.
+// c:       Codec whose output file to write to.
 // returns: Void.
 //
-void flush_pairs(int outfile);
+void flush_pairs(Codec *c);
 
 //
-// "Reads" a pair (symbol and index) from the input file.
-// The "read" symbol is placed in the pointer to sym (pass by reference).
+// "Reads" a pair (index and symbol) from the input file.
 // The "read" index is placed in the pointer to index (pass by reference).
+// The "read" symbol is placed in the pointer to sym (pass by reference).
 // In reality, a block of pairs is read into a buffer.
-// An index keeps track of the current bit in the buffer.
-// Once all bits have been processed, another block is read.
-// The first 8 bits of the pair constitute the symbol, starting from the LSB.
-// The next bit_len bits constitutes the index, starting from the the LSB.
+// Bits are loaded from the buffer into a 64-bit accumulator a word at a time.
+// Once all bytes of the buffer have been loaded, another block is read.
+// The first bit_len bits of the pair constitute the index, starting from
+// the LSB. The next 8 bits constitute the symbol, starting from the LSB.
 // Returns true if there are pairs left to read in the buffer, else false.
 // There are pairs left to read if the read index is not STOP_INDEX.
 //
-// infile:  File descriptor of the input file to read from.
+// c:       Codec whose input file to read from.
+// code:    Pointer to memory which stores the read index.
 // sym:     Pointer to memory which stores the read symbol.
-// index:   Pointer to memory which stores the read index.
 // bit_len: Length in bits of the index to read.
 // returns: True if there are pairs left to read, false otherwise.
 //
-bool read_pair(int infile, uint16_t *code, uint8_t *sym, uint8_t bit_len);
+bool read_pair(Codec *c, uint32_t *code, uint8_t *sym, uint8_t bit_len);
+
+//
+// "Reads" a code of an LZW stream, which has no symbols after codes.
+// The first bit_len bits constitute the code, starting from the LSB.
+//
+// c:       Codec whose input file to read from.
+// code:    Pointer to memory which stores the read code.
+// bit_len: Length in bits of the code to read.
+// returns: True if there are codes left to read, false once the STOP_CODE
+//          is read or the input ended.
+//
+bool read_code(Codec *c, uint32_t *code, uint8_t bit_len);
+
+//
+// Returns the number of bits read_pair() can take without reaching past the
+// end of the input. Only a memory input has a known end, so the count only
+// includes the input itself when the infile is MEM_FD.
+//
+// c:       Codec that reads pairs.
+// returns: Number of bits left to read.
+//
+uint64_t pair_bits_left(Codec *c);
+
+//
+// Buffers a block of pairs of an entropy coded stream, coded whichever way
+// takes fewer bits. The codes of all pairs come first, and the symbols of
+// all pairs follow from the next whole byte of the body on. A block with no
+// pairs ends the stream.
+//
+// c:       Codec whose output file to write to.
+// codes:   Codes of the pairs, the codes of a reset are pairs of their own.
+// syms:    Symbols of the pairs, unused by LZW.
+// npairs:  Number of pairs in the block, at most BLOCK_PAIRS.
+// returns: Void.
+//
+void buffer_block(Codec *c, uint32_t *codes, uint8_t *syms, uint32_t npairs);
+
+//
+// "Reads" a block of pairs of an entropy coded stream. The body of the block
+// is copied into the block buffer of the Codec, and then the codes and the
+// symbols are decoded from there, each section in a loop of its own. Raw
+// codes are unpacked two at a time and raw symbols copied as they are, and
+// a Huffman code is decoded with a single table lookup.
+//
+// c:       Codec whose input file to read from.
+// codes:   Array of BLOCK_PAIRS codes to store the codes of the block into.
+// syms:    Array of BLOCK_PAIRS symbols to store the symbols into.
+// npairs:  Pointer to memory which stores the number of pairs read.
+// returns: DECODE_MORE if a block was read, DECODE_DONE at the end of the
+//          stream and DECODE_CORRUPT if the block is invalid.
+//
+int read_block(Codec *c, uint32_t *codes, uint8_t *syms, uint32_t *npairs);
+
+//
+// Returns whether read_block() can take a whole block without reaching
+// past the end of the input, counted the same way as pair_bits_left().
+//
+// c:       Codec that reads blocks.
+// returns: True if the next block is buffered, false otherwise.
+//
+bool block_buffered(Codec *c);
+
+//
+// Buffers the CRC32C of the input of an encoder, which follows the end of
+// the stream.
+//
+// c:       Codec whose output file to write to.
+// returns: Void.
+//
+void buffer_checksum(Codec *c);
+
+//
+// "Reads" the CRC32C that follows the end of a stream, and checks it against
+// the CRC32C of the output of a decoder. The output has to be flushed first.
+//
+// c:       Codec whose input file to read from.
+// returns: True if the checksums match, false if they don't or the input
+//          ended.
+//
+bool read_checksum(Codec *c);
+
+//
+// Buffers a single symbol, the buffer is written out once it fills.
+//
+// c:       Codec whose output file to write to.
+// sym:     Symbol to buffer.
+// returns: Void.
+//
+void buffer_sym(Codec *c, uint8_t sym);
 
 //
 // Buffers a Word, or more specifically, the symbols of a Word.
-// Each symbol of the Word is placed into a buffer.
+// The symbols of the Word are copied from the history of the WordTable of
+// the Codec into a buffer, as many at a time as fit.
 // The buffer is written out when it is filled.
 //
-// outfile: File descriptor of the output file to write to.
+// c:       Codec whose output file to write to.
 // w:       Word to buffer.
 // returns: Void.
 //
-void buffer_word(int outfile, Word *w);
+void buffer_word(Codec *c, Word *w);
 
 //
 // Writes out any remaining symbols in the buffer.
 //
-// outfile: File descriptor of the output file to write to.
+// c:       Codec whose output file to write to.
 // returns: Void.
 //
-void flush_words(int outfile);
+void flush_words(Codec *c);
 
 #endif
@@ -0,0 +1,222 @@
+#include "lzc.h"
+#include "io.h"
+
+//
+// Clears the internal fields of an LZStream and sets its Codec.
+//
+// s:       LZStream to start.
+// c:       Codec that does the work.
+// returns: Void.
+//
+static void lzc_init(LZStream *s, Codec *c) {
+  s->total_in = 0;
+  s->total_out = 0;
+  s->codec = c;
+  s->out_pos = 0;
+  s->header_read = false;
+  s->finished = false;
+  s->stash = NULL;
+  s->stash_len = 0;
+  s->stash_cap = 0;
+  return;
+}
+
+//
+// Copies as much of the output of the Codec of an LZStream to the caller as
+// there is room for. Once all of it is handed out, the output is rewound so
+// the Codec reuses the same memory.
+//
+// s:       LZStream to drain.
+// returns: True if all output of the Codec has been handed out.
+//
+static bool lzc_drain(LZStream *s) {
+  Codec *c = s->codec;
+  uint64_t left = c->out_len - s->out_pos;
+  uint64_t n = left < s->avail_out ? left : s->avail_out;
+  if (n > 0) {
+    memcpy(s->next_out, c->out_mem + s->out_pos, n);
+  }
+  s->next_out += n;
+  s->avail_out -= n;
+  s->total_out += n;
+  s->out_pos += n;
+  if (s->out_pos < c->out_len) {
+    return false;
+  }
+  c->out_len = 0;
+  s->out_pos = 0;
+  return true;
+}
+
+//
+// Moves up to LZC_CHUNK bytes of caller input to the end of the stash of a
+// decompressing LZStream.
+//
+// s:       LZStream to take input from.
+// returns: Void.
+//
+static void lzc_stash(LZStream *s) {
+  uint64_t n = s->avail_in < LZC_CHUNK ? s->avail_in : LZC_CHUNK;
+  if (s->stash_len + n > s->stash_cap) {
+    s->stash_cap = s->stash_len + LZC_CHUNK;
+    s->stash = (uint8_t *)realloc(s->stash, s->stash_cap);
+    if (!s->stash) {
+      printf("Error: Failed to allocate memory for LZStream!\n");
+      exit(EXIT_FAILURE);
+    }
+  }
+  if (n > 0) {
+    memcpy(s->stash + s->stash_len, s->next_in, n);
+  }
+  s->stash_len += n;
+  s->next_in += n;
+  s->avail_in -= n;
+  s->total_in += n;
+  return;
+}
+
+//
+// Starts a compression on an LZStream.
+// The FileHeader is produced as the first output of the stream.
+//
+// s:       LZStream to start, the caller fields are left as they are.
+// returns: Void.
+//
+void lzc_encode_init(LZStream *s) {
+  lzc_init(s, encoder_create(MEM_FD, MEM_FD));
+  FileHeader header = { 0 };
+  header.magic = MAGIC;
+  header.width = DEFAULT_WIDTH;
+  header.policy = RESET_FULL;
+  write_header(s->codec, &header);
+  return;
+}
+
+//
+// Compresses as much of the input of an LZStream as there is room for the
+// output of. The phrase the last input bytes belong to is kept in the
+// stream, so output doesn't depend on how the input is split up.
+//
+// s:       LZStream to compress with.
+// finish:  True once all input has been given, which ends the stream.
+// returns: LZC_STREAM_END once finished and all output is handed out,
+//          else LZC_OK.
+//
+int lzc_encode(LZStream *s, bool finish) {
+  Codec *c = s->codec;
+
+  // Only compress more once the output so far has been handed out
+  while (lzc_drain(s)) {
+    if (s->avail_in > 0) {
+      uint64_t n = s->avail_in < LZC_CHUNK ? s->avail_in : LZC_CHUNK;
+      codec_encode_syms(c, s->next_in, n);
+      s->next_in += n;
+      s->avail_in -= n;
+      s->total_in += n;
+    } else if (!finish) {
+      return LZC_OK;
+    } else if (s->finished) {
+      return LZC_STREAM_END;
+    } else {
+      codec_encode_finish(c);
+      s->finished = true;
+    }
+  }
+  return LZC_OK;
+}
+
+//
+// Starts a decompression on an LZStream.
+//
+// s:       LZStream to start, the caller fields are left as they are.
+// returns: Void.
+//
+void lzc_decode_init(LZStream *s) {
+  lzc_init(s, decoder_create(MEM_FD, MEM_FD));
+  return;
+}
+
+//
+// Decompresses as much of the input of an LZStream as there is room for the
+// output of. Input bytes that don't make up a whole pair yet are kept in
+// the stream until the rest of the pair is given. Only streams with the
+// magic number MAGIC or LZW_MAGIC can be decompressed, not framed ones.
+//
+// s:       LZStream to decompress with.
+// returns: LZC_STREAM_END once the STOP_CODE is read and all output is
+//          handed out, LZC_DATA_ERROR if the input is invalid, else LZC_OK.
+//
+int lzc_decode(LZStream *s) {
+  Codec *c = s->codec;
+
+  // Only decompress more once the output so far has been handed out
+  while (lzc_drain(s)) {
+    if (s->finished) {
+      return LZC_STREAM_END;
+    }
+    bool more_in = s->avail_in > 0;
+    lzc_stash(s);
+    c->in_mem = s->stash;
+    c->in_len = s->stash_len;
+    c->in_pos = 0;
+
+    if (!s->header_read) {
+      if (s->stash_len < sizeof(FileHeader)) {
+        if (!more_in) {
+          return LZC_OK;
+        }
+        continue;
+      }
+      FileHeader header;
+      read_header(c, &header);
+      uint8_t width = header.width ? header.width : DEFAULT_WIDTH;
+      bool lzw = header.magic == LZW_MAGIC;
+      uint8_t policy = header.policy & POLICY_MASK;
+      if ((header.magic != MAGIC && !lzw) || width < MIN_WIDTH
+          || width > MAX_WIDTH || policy > RESET_ADAPTIVE
+          || (header.policy & ~POLICY_MASK & ~FLAG_ENTROPY & ~FLAG_CHECKSUM)) {
+        return LZC_DATA_ERROR;
+      }
+      codec_set_width(c, width);
+      codec_set_policy(c, policy, DEFAULT_THRESHOLD);
+      codec_set_lzw(c, lzw);
+      codec_set_entropy(c, header.policy & FLAG_ENTROPY);
+      codec_set_checksum(c, header.policy & FLAG_CHECKSUM);
+      s->header_read = true;
+    }
+
+    int result = codec_decode_syms(c, LZC_CHUNK);
+    flush_words(c);
+
+    // Drop the stash bytes the Codec has read, its bit buffer holds them now
+    s->stash_len -= c->in_pos;
+    memmove(s->stash, s->stash + c->in_pos, s->stash_len);
+    c->in_pos = 0;
+    c->in_len = s->stash_len;
+
+    if (result == DECODE_CORRUPT) {
+      return LZC_DATA_ERROR;
+    }
+    if (result == DECODE_DONE) {
+      s->finished = true;
+    } else if (c->out_len == 0 && !more_in) {
+      return LZC_OK;
+    }
+  }
+  return LZC_OK;
+}
+
+//
+// Ends a compression or decompression, freeing the memory of an LZStream.
+// The LZStream itself belongs to the caller and is not freed.
+//
+// s:       LZStream to end.
+// returns: Void.
+//
+void lzc_end(LZStream *s) {
+  codec_delete(s->codec);
+  free(s->stash);
+  s->codec = NULL;
+  s->stash = NULL;
+  return;
+}
@@ -0,0 +1,111 @@
+#ifndef __LZC_H__
+#define __LZC_H__
+
+#include "codec.h"
+#include <inttypes.h>
+#include <stdbool.h>
+
+//
+// Largest number of bytes taken from the caller or produced by the Codec in
+// one step of a stream, which bounds the memory a stream holds on to.
+//
+#define LZC_CHUNK (1 << 16)
+
+//
+// Results of a call to lzc_encode() or lzc_decode().
+// LZC_OK means the call stopped because it needs more input or more room
+// for output. LZC_STREAM_END means all output has been handed out.
+// LZC_DATA_ERROR means the compressed input is not a valid stream.
+//
+#define LZC_OK 0
+#define LZC_STREAM_END 1
+#define LZC_DATA_ERROR -1
+
+//
+// Struct definition of an LZStream, a compression or decompression that is
+// fed input and drained of output by the caller in pieces of any size.
+// The caller sets next_in/avail_in and next_out/avail_out before each call,
+// which advances them past the bytes it consumed and produced.
+//
+// next_in:     Next input byte.
+// avail_in:    Number of bytes available at next_in.
+// total_in:    Number of input bytes consumed so far.
+// next_out:    Where the next output byte is written.
+// avail_out:   Number of bytes of room left at next_out.
+// total_out:   Number of output bytes produced so far.
+// codec:       Codec that does the work, reading and writing memory.
+// out_pos:     Number of bytes in the output of the Codec already handed out.
+// header_read: True once a decompressing stream has read its FileHeader.
+// finished:    True once the Codec has written the STOP_CODE or read it.
+// stash:       Compressed input a decompressing stream has taken in but
+//              the Codec hasn't read yet, such as half of a pair.
+// stash_len:   Number of bytes in the stash.
+// stash_cap:   Number of bytes allocated for the stash.
+//
+typedef struct LZStream {
+  const uint8_t *next_in;
+  uint64_t avail_in;
+  uint64_t total_in;
+  uint8_t *next_out;
+  uint64_t avail_out;
+  uint64_t total_out;
+  Codec *codec;
+  uint64_t out_pos;
+  bool header_read;
+  bool finished;
+  uint8_t *stash;
+  uint64_t stash_len;
+  uint64_t stash_cap;
+} LZStream;
+
+//
+// Starts a compression on an LZStream.
+// The FileHeader is produced as the first output of the stream.
+//
+// s:       LZStream to start, the caller fields are left as they are.
+// returns: Void.
+//
+void lzc_encode_init(LZStream *s);
+
+//
+// Compresses as much of the input of an LZStream as there is room for the
+// output of. The phrase the last input bytes belong to is kept in the
+// stream, so output doesn't depend on how the input is split up.
+//
+// s:       LZStream to compress with.
+// finish:  True once all input has been given, which ends the stream.
+// returns: LZC_STREAM_END once finished and all output is handed out,
+//          else LZC_OK.
+//
+int lzc_encode(LZStream *s, bool finish);
+
+//
+// Starts a decompression on an LZStream.
+//
+// s:       LZStream to start, the caller fields are left as they are.
+// returns: Void.
+//
+void lzc_decode_init(LZStream *s);
+
+//
+// Decompresses as much of the input of an LZStream as there is room for the
+// output of. Input bytes that don't make up a whole pair yet are kept in
+// the stream until the rest of the pair is given. Only streams with the
+// magic number MAGIC or LZW_MAGIC can be decompressed, not framed ones.
+//
+// s:       LZStream to decompress with.
+// returns: LZC_STREAM_END once the STOP_CODE is read and all output is
+//          handed out, LZC_DATA_ERROR if the input is invalid, else LZC_OK.
+//
+int lzc_decode(LZStream *s);
+
+//
+// Ends a compression or decompression, freeing the memory of an LZStream.
+// The LZStream itself belongs to the caller and is not freed.
+//
+// s:       LZStream to end.
+// returns: Void.
+//
+void lzc_end(LZStream *s);
+
+#endif
@@ -0,0 +1,463 @@
+#include "bv.h"
+#include "codec.h"
+#include "dict.h"
+#include "io.h"
+#include "trie.h"
+#include "word.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// Defined option for the command line arguements
+#define OPTIONS "n:w:c:p:"
+
+// Number of timed runs of each primitive, the fastest one is reported
+#define RUNS 11
+
+// Number of operations in a run, baseline files and allowed regression
+uint64_t ops = 1 << 22;
+char *write_file = NULL;
+char *compare_file = NULL;
+double percent = 10;
+
+//
+// Struct definition of a Micro, one primitive to benchmark.
+//
+// name:    Name of the primitive, also its key in a baseline file.
+// setup:   Prepares the state for ops operations, NULL if there is none.
+// run:     Performs ops operations and returns a checksum of them, so the
+//          compiler can't drop the work.
+// ns:      Nanoseconds per operation of the fastest run.
+// cycles:  Reference cycles per operation of the fastest run.
+//
+typedef struct Micro {
+  const char *name;
+  void (*setup)(void);
+  uint64_t (*run)(void);
+  double ns;
+  double cycles;
+} Micro;
+
+// Fixed workload shared by the primitives, generated before any timing
+static uint8_t *syms;
+static uint16_t *codes;
+static uint8_t *lens;
+static uint32_t *bits;
+
+// State the primitives work on
+static BitVector *bv;
+static Trie *trie;
+static Dict *dict;
+static WordTable *wt;
+static Codec *codec;
+
+//
+// Returns the next number of a xorshift64* generator.
+//
+// state:   State of the generator.
+// returns: Next pseudo-random number.
+//
+static uint64_t rng(uint64_t *state) {
+  *state ^= *state >> 12;
+  *state ^= *state << 25;
+  *state ^= *state >> 27;
+  return *state * 0x2545f4914f6cdd1d;
+}
+
+//
+// Generates the workload: symbols skewed towards a small alphabet like
+// text, codes that are valid for the next code at each step the way an
+// encoder assigns them, the bit length of each code and bit indices.
+//
+// returns: Void.
+//
+static void workload_create(void) {
+  syms = (uint8_t *)malloc(ops);
+  codes = (uint16_t *)malloc(ops * sizeof(uint16_t));
+  lens = (uint8_t *)malloc(ops);
+  bits = (uint32_t *)malloc(ops * sizeof(uint32_t));
+  if (!syms || !codes || !lens || !bits) {
+    printf("Error: Failed to allocate memory for workload!\n");
+    exit(EXIT_FAILURE);
+  }
+
+  uint64_t state = 0x9e3779b97f4a7c15;
+  uint16_t next_code = START_CODE;
+  for (uint64_t i = 0; i < ops; i++) {
+    uint64_t r = rng(&state);
+    syms[i] = 'a' + r % ((r >> 8) % 26 + 1);
+    codes[i] = EMPTY_CODE + (r >> 16) % (next_code - EMPTY_CODE);
+    lens[i] = 64 - __builtin_clzll(next_code);
+    bits[i] = (r >> 32) % (BLOCK * 8);
+    next_code = next_code + 1 == MAX_CODE ? START_CODE : next_code + 1;
+  }
+  return;
+}
+
+//
+// Returns the time of a monotonic clock in nanoseconds.
+//
+static uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+//
+// Returns the time stamp counter, or zero where there is none.
+// The counter ticks at a fixed reference rate rather than the core clock.
+//
+static uint64_t now_cycles(void) {
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  return 0;
+#endif
+}
+
+static uint64_t run_bv_set_bit(void) {
+  for (uint64_t i = 0; i < ops; i++) {
+    bv_set_bit(bv, bits[i]);
+  }
+  return bv->vector[0];
+}
+
+static uint64_t run_bv_get_bit(void) {
+  uint64_t sum = 0;
+  for (uint64_t i = 0; i < ops; i++) {
+    sum += bv_get_bit(bv, bits[i]);
+  }
+  return sum;
+}
+
+static void setup_trie(void) {
+  trie_reset(trie);
+  return;
+}
+
+//
+// Inserts phrases of the workload symbols into the Trie the way the
+// encoder did before the Dict, creating a node for every new phrase.
+//
+static uint64_t run_trie_node_create(void) {
+  TrieNode *curr = trie->root;
+  uint16_t next_code = START_CODE;
+  for (uint64_t i = 0; i < ops; i++) {
+    TrieNode *next = trie_step(curr, syms[i]);
+    if (next) {
+      curr = next;
+      continue;
+    }
+    curr->children[syms[i]] = trie_node_create(trie, next_code);
+    curr = trie->root;
+    if (++next_code == MAX_CODE) {
+      trie_reset(trie);
+      next_code = START_CODE;
+    }
+  }
+  return next_code;
+}
+
+//
+// Walks phrases of the workload symbols through the Trie left by
+// run_trie_node_create(), back to the root whenever a phrase ends.
+//
+static uint64_t run_trie_step(void) {
+  TrieNode *curr = trie->root;
+  uint64_t sum = 0;
+  for (uint64_t i = 0; i < ops; i++) {
+    TrieNode *next = trie_step(curr, syms[i]);
+    curr = next ? next : trie->root;
+    sum += curr->code;
+  }
+  return sum;
+}
+
+static void setup_dict(void) {
+  dict_reset(dict);
+  return;
+}
+
+//
+// Runs the encoder loop over the workload symbols with the Dict alone,
+// which is a dict_step() per symbol and a dict_insert() per phrase.
+//
+static uint64_t run_dict_step(void) {
+  uint32_t curr = EMPTY_CODE;
+  uint32_t next_code = START_CODE;
+  for (uint64_t i = 0; i < ops; i++) {
+    uint32_t step = dict_step(dict, curr, syms[i]);
+    if (step != STOP_CODE) {
+      curr = step;
+      continue;
+    }
+    dict_insert(dict, curr, syms[i], next_code);
+    curr = EMPTY_CODE;
+    if (++next_code == MAX_CODE) {
+      dict_reset(dict);
+      next_code = START_CODE;
+    }
+  }
+  return next_code;
+}
+
+static void setup_codec(void) {
+  codec_reset(codec);
+  codec->in_mem = NULL;
+  codec->in_len = 0;
+  return;
+}
+
+static uint64_t run_buffer_pair(void) {
+  for (uint64_t i = 0; i < ops; i++) {
+    buffer_pair(codec, codes[i], syms[i], lens[i]);
+  }
+  flush_pairs(codec);
+  return codec->out_len;
+}
+
+//
+// Buffers the pairs of the workload into memory so that run_read_pair()
+// reads the same pairs back.
+//
+static void setup_read_pair(void) {
+  setup_codec();
+  run_buffer_pair();
+  codec->in_mem = codec->out_mem;
+  codec->in_len = codec->out_len;
+  codec->in_pos = 0;
+  codec->rbytes = 0;
+  codec->bit_index = 0;
+  codec->bit_acc = 0;
+  codec->acc_bits = 0;
+  return;
+}
+
+static uint64_t run_read_pair(void) {
+  uint32_t code = 0;
+  uint8_t sym = 0;
+  uint64_t sum = 0;
+  for (uint64_t i = 0; i < ops; i++) {
+    read_pair(codec, &code, &sym, lens[i]);
+    sum += code + sym;
+  }
+  return sum;
+}
+
+static void setup_wt(void) {
+  wt_reset(wt);
+  return;
+}
+
+//
+// Appends a symbol to a word of the workload codes the way the decoder
+// does, resetting the WordTable whenever it fills up.
+//
+static uint64_t run_word_append_sym(void) {
+  uint32_t next_code = START_CODE;
+  uint64_t sum = 0;
+  for (uint64_t i = 0; i < ops; i++) {
+    Word *w = word_append_sym(wt, codes[i], syms[i], next_code);
+    sum += w->len;
+    if (++next_code == MAX_CODE) {
+      wt_reset(wt);
+      next_code = START_CODE;
+    }
+  }
+  return sum;
+}
+
+//
+// Buffers the words left in the WordTable by run_word_append_sym().
+// Operations are counted in words, which are as long as the workload makes
+// them, not in bytes.
+//
+static void setup_buffer_word(void) {
+  setup_codec();
+  setup_wt();
+  run_word_append_sym();
+  return;
+}
+
+static uint64_t run_buffer_word(void) {
+  for (uint64_t i = 0; i < ops; i++) {
+    buffer_word(codec, &wt->words[START_CODE + i % (MAX_CODE - START_CODE)]);
+    // Keep the output the size of a block or two so it stays in cache
+    if (codec->out_len > BLOCK) {
+      codec->out_len = 0;
+    }
+  }
+  return codec->byte_count;
+}
+
+//
+// Primitives in the order they run, since trie_step walks the Trie that
+// trie_node_create builds and buffer_word buffers the words of the
+// WordTable.
+//
+static Micro micros[] = {
+  { "bv_set_bit", NULL, run_bv_set_bit, 0, 0 },
+  { "bv_get_bit", NULL, run_bv_get_bit, 0, 0 },
+  { "trie_node_create", setup_trie, run_trie_node_create, 0, 0 },
+  { "trie_step", NULL, run_trie_step, 0, 0 },
+  { "dict_step", setup_dict, run_dict_step, 0, 0 },
+  { "buffer_pair", setup_codec, run_buffer_pair, 0, 0 },
+  { "read_pair", setup_read_pair, run_read_pair, 0, 0 },
+  { "word_append_sym", setup_wt, run_word_append_sym, 0, 0 },
+  { "buffer_word", setup_buffer_word, run_buffer_word, 0, 0 },
+};
+
+#define NMICROS (sizeof(micros) / sizeof(micros[0]))
+
+//
+// Times the runs of a primitive and keeps the fastest.
+//
+// m:       Primitive to time.
+// returns: Checksum of the last run.
+//
+static uint64_t measure(Micro *m) {
+  uint64_t sum = 0;
+  // The first run warms the caches and the state up and isn't timed
+  for (int i = 0; i <= RUNS; i++) {
+    if (m->setup) {
+      m->setup();
+    }
+    uint64_t start = now_ns();
+    uint64_t start_cycles = now_cycles();
+    sum = m->run();
+    uint64_t cycles = now_cycles() - start_cycles;
+    uint64_t ns = now_ns() - start;
+    if (i == 1 || (i > 1 && (double)ns / ops < m->ns)) {
+      m->ns = (double)ns / ops;
+      m->cycles = (double)cycles / ops;
+    }
+  }
+  return sum;
+}
+
+//
+// Compares the results with a baseline file of "name ns" lines.
+//
+// path:    Path of the baseline file.
+// returns: True if no primitive is more than percent slower.
+//
+static bool compare(const char *path) {
+  FILE *f = fopen(path, "r");
+  if (!f) {
+    printf("Error: Failed to open %s!\n", path);
+    exit(EXIT_FAILURE);
+  }
+  bool ok = true;
+  char name[64];
+  double ns = 0;
+  printf("\n%-18s %10s %10s %8s\n", "primitive", "base ns", "ns", "change");
+  while (fscanf(f, "%63s %lf", name, &ns) == 2) {
+    for (uint32_t i = 0; i < NMICROS; i++) {
+      if (strcmp(name, micros[i].name) != 0) {
+        continue;
+      }
+      double change = 100 * (micros[i].ns - ns) / ns;
+      bool regressed = change > percent;
+      printf("%-18s %10.3f %10.3f %+7.1f%%%s\n", name, ns, micros[i].ns,
+          change, regressed ? " REGRESSED" : "");
+      ok = ok && !regressed;
+    }
+  }
+  fclose(f);
+  return ok;
+}
+
+//
+// This function parses through the command line arguments
+// and sets the appropriate flags for the program
+//
+// int argc:		The number of command line arguements to parse through
+// char **argv:		Char pointer holding all the arguments
+//
+void get_options(int argc, char **argv);
+
+int main(int argc, char **argv) {
+  get_options(argc, argv);
+
+  workload_create();
+  bv = bv_create(BLOCK * 8);
+  trie = trie_create();
+  dict = dict_create(DEFAULT_WIDTH);
+  // buffer_word() takes its words from the WordTable of a decoder
+  codec = decoder_create(MEM_FD, MEM_FD);
+  wt = codec->wt;
+
+  printf("%-18s %10s %10s\n", "primitive", "ns/op", "cycles/op");
+  uint64_t sum = 0;
+  for (uint32_t i = 0; i < NMICROS; i++) {
+    sum += measure(&micros[i]);
+    printf("%-18s %10.3f %10.2f\n", micros[i].name, micros[i].ns,
+        micros[i].cycles);
+  }
+  // The checksum only has to be used, its value means nothing
+  if (sum == 1) {
+    printf("\n");
+  }
+
+  if (write_file) {
+    FILE *f = fopen(write_file, "w");
+    if (!f) {
+      printf("Error: Failed to open %s!\n", write_file);
+      exit(EXIT_FAILURE);
+    }
+    for (uint32_t i = 0; i < NMICROS; i++) {
+      fprintf(f, "%s %.3f\n", micros[i].name, micros[i].ns);
+    }
+    fclose(f);
+  }
+
+  bool ok = compare_file ? compare(compare_file) : true;
+
+  codec_delete(codec);
+  dict_delete(dict);
+  trie_delete(trie);
+  bv_delete(bv);
+  free(syms);
+  free(codes);
+  free(lens);
+  free(bits);
+  return ok ? 0 : EXIT_FAILURE;
+}
+
+//
+// This function parses through the command line arguments
+// and sets the appropriate flags for the program
+//
+// int argc:            The number of command line arguements to parse through
+// char **argv:         Char pointer holding all the arguments
+//
+void get_options(int argc, char **argv) {
+  int c = 0;
+  // Loop until all command line arguements are read
+  while ((c = getopt(argc, argv, OPTIONS)) != -1) {
+    // The number of operations in a run
+    if (c == 'n') {
+      ops = strtoull(optarg, NULL, 10);
+      if (ops == 0) {
+        printf("Error: Number of operations must be at least 1!\n");
+        exit(EXIT_FAILURE);
+      }
+      // The baseline file to write
+    } else if (c == 'w') {
+      write_file = optarg;
+      // The baseline file to compare with
+    } else if (c == 'c') {
+      compare_file = optarg;
+      // The allowed regression in percent
+    } else if (c == 'p') {
+      percent = atof(optarg);
+    } else {
+      exit(EXIT_FAILURE);
+    }
+  }
+}
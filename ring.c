@@ -0,0 +1,411 @@
+#include "ring.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+//
+// Thread of a reading Ring. Fills the slots in order as long as one is
+// free, each with what a single read() returns so that the bytes of a pipe
+// are handed over as soon as they come, and stops once the file ends. It
+// can only be cancelled inside read(), which is never with the lock held.
+//
+// arg:     Ring to fill.
+// returns: NULL.
+//
+static void *ring_reader(void *arg) {
+  Ring *r = (Ring *)arg;
+  pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
+
+  pthread_mutex_lock(&r->lock);
+  while (!r->done) {
+    // Wait until the Codec has drained a slot or wants no more bytes
+    while (r->filled - r->drained == RING_SLOTS && !r->stop) {
+      pthread_cond_wait(&r->cond, &r->lock);
+    }
+    if (r->stop) {
+      break;
+    }
+    uint32_t slot = r->filled % RING_SLOTS;
+    uint8_t *buf = r->slots + (uint64_t)slot * RING_SLOT_SIZE;
+
+    // Fill the slot without holding the lock
+    pthread_mutex_unlock(&r->lock);
+    ssize_t n = 0;
+    do {
+      pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);
+      n = read(r->fd, buf, RING_SLOT_SIZE);
+      pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
+    } while (n < 0 && errno == EINTR);
+    if (n < 0) {
+      printf("Error: Failed to read infile!\n");
+      exit(EXIT_FAILURE);
+    }
+    pthread_mutex_lock(&r->lock);
+
+    r->lens[slot] = n;
+    r->filled++;
+    r->done = n == 0;
+    pthread_cond_broadcast(&r->cond);
+  }
+  pthread_mutex_unlock(&r->lock);
+  return NULL;
+}
+
+//
+// Thread of a writing Ring. Writes out the slots in order as the Codec
+// fills them, until the Codec is done and every slot is written.
+//
+// arg:     Ring to write out.
+// returns: NULL.
+//
+static void *ring_writer(void *arg) {
+  Ring *r = (Ring *)arg;
+
+  pthread_mutex_lock(&r->lock);
+  while (true) {
+    // Wait until the Codec has filled a slot or has nothing more to write
+    while (r->drained == r->filled && !r->done) {
+      pthread_cond_wait(&r->cond, &r->lock);
+    }
+    if (r->drained == r->filled) {
+      break;
+    }
+    uint32_t slot = r->drained % RING_SLOTS;
+    uint8_t *buf = r->slots + (uint64_t)slot * RING_SLOT_SIZE;
+    uint32_t len = r->lens[slot];
+
+    // Write out the slot without holding the lock
+    pthread_mutex_unlock(&r->lock);
+    uint32_t written = 0;
+    while (written < len) {
+      ssize_t n = write(r->fd, buf + written, len - written);
+      if (n < 0 && errno != EINTR) {
+        printf("Error: Failed to write to outfile!\n");
+        exit(EXIT_FAILURE);
+      }
+      written += n > 0 ? n : 0;
+    }
+    pthread_mutex_lock(&r->lock);
+
+    r->drained++;
+    pthread_cond_broadcast(&r->cond);
+  }
+  pthread_mutex_unlock(&r->lock);
+  return NULL;
+}
+
+//
+// Thread of a reading Ring whose file is read through a Uring. A read is
+// in flight for every free slot at once, each at the offset the slot takes
+// in the file, and a read that comes back short is resubmitted for the
+// rest of its slot until the file ends. Reads complete in any order, so a
+// slot is only handed to the Codec once every slot before it has been.
+//
+// arg:     Ring to fill.
+// returns: NULL.
+//
+static void *ring_uring_reader(void *arg) {
+  Ring *r = (Ring *)arg;
+  pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
+  uint64_t issued = 0;
+  uint32_t inflight = 0;
+  bool eof = false;
+
+  pthread_mutex_lock(&r->lock);
+  while (!r->stop && !r->done) {
+    // Read into every slot the Codec has drained
+    while (!eof && issued - r->drained < RING_SLOTS) {
+      uint32_t slot = issued % RING_SLOTS;
+      r->offsets[slot] = r->offset;
+      r->io_lens[slot] = 0;
+      uring_read(r->uring, r->fd, r->slots + (uint64_t)slot * RING_SLOT_SIZE,
+          RING_SLOT_SIZE, r->offset, slot);
+      r->offset += RING_SLOT_SIZE;
+      issued++;
+      inflight++;
+    }
+    if (inflight == 0) {
+      pthread_cond_wait(&r->cond, &r->lock);
+      continue;
+    }
+
+    // Wait for a read without holding the lock
+    pthread_mutex_unlock(&r->lock);
+    uint64_t slot = 0;
+    int32_t n = uring_wait(r->uring, &slot);
+    pthread_mutex_lock(&r->lock);
+
+    if (n < 0 && n != -EINTR && n != -EAGAIN) {
+      printf("Error: Failed to read infile!\n");
+      exit(EXIT_FAILURE);
+    }
+    r->io_lens[slot] += n > 0 ? n : 0;
+    if (n != 0 && r->io_lens[slot] < RING_SLOT_SIZE) {
+      uint32_t got = r->io_lens[slot];
+      uring_read(r->uring, r->fd,
+          r->slots + slot * RING_SLOT_SIZE + got, RING_SLOT_SIZE - got,
+          r->offsets[slot] + got, slot);
+      continue;
+    }
+    r->ready[slot] = true;
+    eof |= n == 0;
+    inflight--;
+
+    // Hand the slots that are read on in order, up to the end of the file
+    while (r->filled < issued && r->ready[r->filled % RING_SLOTS]) {
+      uint32_t next = r->filled % RING_SLOTS;
+      r->ready[next] = false;
+      r->lens[next] = r->io_lens[next];
+      r->filled++;
+      if (r->lens[next] < RING_SLOT_SIZE) {
+        r->done = true;
+        break;
+      }
+    }
+    pthread_cond_broadcast(&r->cond);
+  }
+
+  // Reads past the end of the file or of what the Codec wants still have
+  // to complete before their slots can be freed
+  pthread_mutex_unlock(&r->lock);
+  while (inflight) {
+    uint64_t slot = 0;
+    uring_wait(r->uring, &slot);
+    inflight--;
+  }
+  return NULL;
+}
+
+//
+// Thread of a writing Ring whose file is written through a Uring. A write
+// is in flight for every slot the Codec has filled, each at the offset the
+// slot takes in the file, and a write that comes back short is resubmitted
+// for the rest of its slot. A slot is only handed back to the Codec once
+// every slot before it has been, and the offset of the file is moved past
+// all of them at the end, as write() would have left it.
+//
+// arg:     Ring to write out.
+// returns: NULL.
+//
+static void *ring_uring_writer(void *arg) {
+  Ring *r = (Ring *)arg;
+  uint64_t issued = 0;
+  uint32_t inflight = 0;
+
+  pthread_mutex_lock(&r->lock);
+  while (true) {
+    // Write out every slot the Codec has filled
+    while (issued < r->filled) {
+      uint32_t slot = issued % RING_SLOTS;
+      r->offsets[slot] = r->offset;
+      r->io_lens[slot] = 0;
+      uring_write(r->uring, r->fd, r->slots + (uint64_t)slot * RING_SLOT_SIZE,
+          r->lens[slot], r->offset, slot);
+      r->offset += r->lens[slot];
+      issued++;
+      inflight++;
+    }
+    if (inflight == 0) {
+      if (r->done) {
+        break;
+      }
+      pthread_cond_wait(&r->cond, &r->lock);
+      continue;
+    }
+
+    // Wait for a write without holding the lock
+    pthread_mutex_unlock(&r->lock);
+    uint64_t slot = 0;
+    int32_t n = uring_wait(r->uring, &slot);
+    pthread_mutex_lock(&r->lock);
+
+    if (n <= 0 && n != -EINTR && n != -EAGAIN) {
+      printf("Error: Failed to write to outfile!\n");
+      exit(EXIT_FAILURE);
+    }
+    r->io_lens[slot] += n > 0 ? n : 0;
+    if (r->io_lens[slot] < r->lens[slot]) {
+      uint32_t put = r->io_lens[slot];
+      uring_write(r->uring, r->fd, r->slots + slot * RING_SLOT_SIZE + put,
+          r->lens[slot] - put, r->offsets[slot] + put, slot);
+      continue;
+    }
+    r->ready[slot] = true;
+    inflight--;
+
+    // Hand the slots that are written back in order
+    while (r->drained < issued && r->ready[r->drained % RING_SLOTS]) {
+      r->ready[r->drained % RING_SLOTS] = false;
+      r->drained++;
+    }
+    pthread_cond_broadcast(&r->cond);
+  }
+  pthread_mutex_unlock(&r->lock);
+
+  lseek(r->fd, r->offset, SEEK_SET);
+  return NULL;
+}
+
+//
+// Constructor for a Ring, which also starts its thread. A reading Ring
+// starts reading the file straight away. A regular file is read or written
+// through a Uring if the kernel has one, anything else or a kernel without
+// one with read() or write().
+//
+// fd:      File descriptor of the file to read or write.
+// writer:  True to write to the file, false to read from it.
+// returns: Pointer to a Ring that has been allocated memory.
+//
+Ring *ring_create(int fd, bool writer) {
+  Ring *r = (Ring *)calloc(1, sizeof(Ring));
+  if (!r) {
+    printf("Error: Failed to allocate memory for Ring!\n");
+    exit(EXIT_FAILURE);
+  }
+  r->fd = fd;
+  r->writer = writer;
+  r->slots = (uint8_t *)malloc((uint64_t)RING_SLOTS * RING_SLOT_SIZE);
+  if (!r->slots) {
+    printf("Error: Failed to allocate memory for Ring!\n");
+    exit(EXIT_FAILURE);
+  }
+
+  // Only a regular file has offsets to read and write the slots at, and
+  // one that is appended to ignores them
+  struct stat st;
+  off_t offset = lseek(fd, 0, SEEK_CUR);
+  if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && offset >= 0
+      && !(fcntl(fd, F_GETFL) & O_APPEND)) {
+    r->uring = uring_create(RING_SLOTS, r->slots,
+        (uint64_t)RING_SLOTS * RING_SLOT_SIZE);
+    r->offset = offset;
+  }
+
+  pthread_mutex_init(&r->lock, NULL);
+  pthread_cond_init(&r->cond, NULL);
+  void *(*run)(void *) = writer ? ring_writer : ring_reader;
+  if (r->uring) {
+    run = writer ? ring_uring_writer : ring_uring_reader;
+  }
+  if (pthread_create(&r->thread, NULL, run, r)) {
+    printf("Error: Failed to create thread!\n");
+    exit(EXIT_FAILURE);
+  }
+  return r;
+}
+
+//
+// Destructor for a Ring. A writing Ring first writes out what is left in
+// it, and a reading Ring stops its thread even if the file hasn't ended.
+//
+// r:       Ring to free allocated memory for.
+// returns: Void.
+//
+void ring_delete(Ring *r) {
+  pthread_mutex_lock(&r->lock);
+  if (r->writer) {
+    // Hand over the slot the Codec was filling, however full it is
+    if (r->pos) {
+      r->lens[r->filled % RING_SLOTS] = r->pos;
+      r->filled++;
+      r->pos = 0;
+    }
+    r->done = true;
+  } else {
+    r->stop = true;
+  }
+  pthread_cond_broadcast(&r->cond);
+  pthread_mutex_unlock(&r->lock);
+
+  // A reader may be blocked on a pipe whose writer never closes it
+  if (!r->writer) {
+    pthread_cancel(r->thread);
+  }
+  pthread_join(r->thread, NULL);
+  if (r->uring) {
+    uring_delete(r->uring);
+  }
+
+  pthread_mutex_destroy(&r->lock);
+  pthread_cond_destroy(&r->cond);
+  free(r->slots);
+  free(r);
+  return;
+}
+
+//
+// Takes bytes out of a reading Ring, waiting for its thread to read them
+// in if it hasn't yet. Only fewer bytes than asked for are returned once
+// the file has ended.
+//
+// r:       Ring to read from.
+// buf:     Buffer to store the bytes into.
+// len:     Number of bytes to read.
+// returns: Number of bytes read.
+//
+uint32_t ring_read(Ring *r, uint8_t *buf, uint32_t len) {
+  uint32_t total = 0;
+  pthread_mutex_lock(&r->lock);
+  while (total < len) {
+    while (r->drained == r->filled && !r->done) {
+      pthread_cond_wait(&r->cond, &r->lock);
+    }
+    if (r->drained == r->filled) {
+      break;
+    }
+
+    // Copy out of the oldest filled slot, and hand it back once it is empty
+    uint32_t slot = r->drained % RING_SLOTS;
+    uint32_t n = r->lens[slot] - r->pos;
+    n = n < len - total ? n : len - total;
+    memcpy(buf + total, r->slots + (uint64_t)slot * RING_SLOT_SIZE + r->pos,
+        n);
+    total += n;
+    r->pos += n;
+    if (r->pos == r->lens[slot]) {
+      r->pos = 0;
+      r->drained++;
+      pthread_cond_broadcast(&r->cond);
+    }
+  }
+  pthread_mutex_unlock(&r->lock);
+  return total;
+}
+
+//
+// Puts bytes into a writing Ring, handing each slot to its thread as soon
+// as it is full and waiting for a free slot if every one is full.
+//
+// r:       Ring to write to.
+// buf:     Bytes to write.
+// len:     Number of bytes to write.
+// returns: Void.
+//
+void ring_write(Ring *r, const uint8_t *buf, uint32_t len) {
+  pthread_mutex_lock(&r->lock);
+  while (len) {
+    // A new slot is only started once the thread has written it out
+    while (r->pos == 0 && r->filled - r->drained == RING_SLOTS) {
+      pthread_cond_wait(&r->cond, &r->lock);
+    }
+    uint32_t slot = r->filled % RING_SLOTS;
+    uint32_t n = RING_SLOT_SIZE - r->pos;
+    n = n < len ? n : len;
+    memcpy(r->slots + (uint64_t)slot * RING_SLOT_SIZE + r->pos, buf, n);
+    buf += n;
+    len -= n;
+    r->pos += n;
+    if (r->pos == RING_SLOT_SIZE) {
+      r->lens[slot] = RING_SLOT_SIZE;
+      r->filled++;
+      r->pos = 0;
+      pthread_cond_broadcast(&r->cond);
+    }
+  }
+  pthread_mutex_unlock(&r->lock);
+  return;
+}
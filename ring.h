@@ -0,0 +1,118 @@
+#ifndef __RING_H__
+#define __RING_H__
+
+#include "uring.h"
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdbool.h>
+
+//
+// Number of slots of a Ring and the number of bytes of each. A slot is
+// read or written with a single syscall where the file allows it, so it is
+// much larger than the BLOCK a Codec reads and writes at a time.
+//
+#define RING_SLOTS 4
+#define RING_SLOT_SIZE (1 << 18)
+
+//
+// Struct definition of a Ring of buffers between the thread of a Codec and
+// a thread of its own that does the reads or writes of one file, so that
+// the Codec keeps working while the file waits on the disk or the network.
+// A reading Ring has its thread fill slots ahead of the Codec, and a
+// writing Ring has it write out the slots the Codec filled. Slots are
+// filled and drained in the same order, so each is only touched by one of
+// the two threads at a time. The thread reads or writes a regular file
+// through a Uring where it can, with a read or write in flight for every
+// slot it has, and any other file with read() or write() one slot at a time.
+//
+// lock:      Mutex that guards the counters and flags.
+// cond:      Signalled when a slot is filled or drained or the Ring stops.
+// thread:    Thread that reads or writes the file.
+// fd:        File descriptor of the file.
+// writer:    True if the Ring writes to the file, false if it reads.
+// slots:     Buffer of RING_SLOTS slots of RING_SLOT_SIZE bytes.
+// lens:      Number of bytes in each filled slot.
+// filled:    Number of slots filled, by the thread for a reading Ring and by
+//            the Codec for a writing one.
+// drained:   Number of slots drained, by the Codec for a reading Ring and by
+//            the thread for a writing one.
+// pos:       Number of bytes of its current slot the Codec has taken out of a
+//            reading Ring or put into a writing one.
+// done:      True once the file has ended for a reading Ring, or once the
+//            Codec has nothing more to write for a writing one.
+// stop:      True once the Codec wants no more bytes from a reading Ring.
+// uring:     Uring the thread reads or writes through, NULL for read() or
+//            write().
+// offset:    Offset in the file of the next slot to read or write through
+//            the Uring.
+// offsets:   Offset in the file of each slot read or written through the
+//            Uring.
+// io_lens:   Number of bytes of each slot read or written so far.
+// ready:     True for each slot whose read or write has completed, until
+//            it is handed on in order.
+//
+typedef struct Ring {
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  pthread_t thread;
+  int fd;
+  bool writer;
+  uint8_t *slots;
+  uint32_t lens[RING_SLOTS];
+  uint64_t filled;
+  uint64_t drained;
+  uint32_t pos;
+  bool done;
+  bool stop;
+  Uring *uring;
+  uint64_t offset;
+  uint64_t offsets[RING_SLOTS];
+  uint32_t io_lens[RING_SLOTS];
+  bool ready[RING_SLOTS];
+} Ring;
+
+//
+// Constructor for a Ring, which also starts its thread. A reading Ring
+// starts reading the file straight away. A regular file is read or written
+// through a Uring if the kernel has one, anything else or a kernel without
+// one with read() or write().
+//
+// fd:      File descriptor of the file to read or write.
+// writer:  True to write to the file, false to read from it.
+// returns: Pointer to a Ring that has been allocated memory.
+//
+Ring *ring_create(int fd, bool writer);
+
+//
+// Destructor for a Ring. A writing Ring first writes out what is left in
+// it, and a reading Ring stops its thread even if the file hasn't ended.
+//
+// r:       Ring to free allocated memory for.
+// returns: Void.
+//
+void ring_delete(Ring *r);
+
+//
+// Takes bytes out of a reading Ring, waiting for its thread to read them
+// in if it hasn't yet. Only fewer bytes than asked for are returned once
+// the file has ended.
+//
+// r:       Ring to read from.
+// buf:     Buffer to store the bytes into.
+// len:     Number of bytes to read.
+// returns: Number of bytes read.
+//
+uint32_t ring_read(Ring *r, uint8_t *buf, uint32_t len);
+
+//
+// Puts bytes into a writing Ring, handing each slot to its thread as soon
+// as it is full and waiting for a free slot if every one is full.
+//
+// r:       Ring to write to.
+// buf:     Bytes to write.
+// len:     Number of bytes to write.
+// returns: Void.
+//
+void ring_write(Ring *r, const uint8_t *buf, uint32_t len);
+
+#endif
@@ -0,0 +1,213 @@
+#include "shared.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+//
+// Number of bits of the hash of a substring, which indexes the counts of
+// the substrings.
+//
+#define DMER_BITS 20
+
+//
+// Opens a file and reads up to len bytes of it, exiting if it can't be
+// opened or read.
+//
+// path:    Path of the file.
+// buf:     Buffer to store the bytes into, NULL to only find the size.
+// len:     Largest number of bytes to read.
+// size:    Pointer to store the size of the file into.
+// returns: Number of bytes read.
+//
+static uint64_t read_file(const char *path, uint8_t *buf, uint64_t len,
+    uint64_t *size) {
+  struct stat st;
+  int fd = open(path, O_RDONLY);
+  if (fd < 0 || fstat(fd, &st) < 0) {
+    printf("Error: Failed to open %s!\n", path);
+    exit(EXIT_FAILURE);
+  }
+  *size = st.st_size;
+  uint64_t total = 0;
+  ssize_t n = 0;
+  while (buf && total < len && (n = read(fd, buf + total, len - total)) > 0) {
+    total += n;
+  }
+  if (n < 0) {
+    printf("Error: Failed to read %s!\n", path);
+    exit(EXIT_FAILURE);
+  }
+  close(fd);
+  return total;
+}
+
+//
+// Reads a shared dictionary from a file, exiting if it can't be read or is
+// larger than SHARED_MAX.
+//
+// path:    Path of the dictionary.
+// len:     Pointer to store the number of bytes of the dictionary into.
+// returns: Bytes of the dictionary, which have been allocated memory.
+//
+uint8_t *shared_load(const char *path, uint32_t *len) {
+  uint64_t size = 0;
+  read_file(path, NULL, 0, &size);
+  if (size == 0 || size > SHARED_MAX) {
+    printf("Error: Dictionary must be between 1 and %d KiB!\n",
+        SHARED_MAX >> 10);
+    exit(EXIT_FAILURE);
+  }
+  uint8_t *dict = (uint8_t *)malloc(size);
+  if (!dict) {
+    printf("Error: Failed to allocate memory for dictionary!\n");
+    exit(EXIT_FAILURE);
+  }
+  *len = read_file(path, dict, size, &size);
+  return dict;
+}
+
+//
+// Writes a shared dictionary to a file, exiting if it can't be written.
+//
+// path:    Path of the dictionary.
+// dict:    Bytes of the dictionary.
+// len:     Number of bytes of the dictionary.
+// returns: Void.
+//
+void shared_save(const char *path, const uint8_t *dict, uint32_t len) {
+  int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC,
+      S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+  if (fd < 0) {
+    printf("Error: Failed to open %s!\n", path);
+    exit(EXIT_FAILURE);
+  }
+  uint32_t total = 0;
+  ssize_t n = 0;
+  while (total < len && (n = write(fd, dict + total, len - total)) > 0) {
+    total += n;
+  }
+  if (total < len || close(fd) < 0) {
+    printf("Error: Failed to write %s!\n", path);
+    exit(EXIT_FAILURE);
+  }
+  return;
+}
+
+//
+// Hashes the substring of SHARED_DMER bytes at a position of the samples.
+//
+// buf:     Samples, with at least 8 readable bytes from the position.
+// returns: Index of the count of the substring.
+//
+static inline uint32_t dmer_hash(const uint8_t *buf) {
+  uint64_t word = 0;
+  memcpy(&word, buf, sizeof(word));
+  word &= (1ull << (8 * SHARED_DMER)) - 1;
+  return (word * 0x9E3779B97F4A7C15ull) >> (64 - DMER_BITS);
+}
+
+//
+// Trains a shared dictionary from sample files. The samples are cut into
+// as many stretches as the dictionary has segments, and from each the
+// segment whose substrings of SHARED_DMER bytes occur in the most samples
+// is taken. The substrings of a segment that is taken no longer count, so
+// later segments cover what it doesn't.
+//
+// paths:   Paths of the sample files.
+// n:       Number of paths.
+// size:    Largest number of bytes of the dictionary.
+// len:     Pointer to store the number of bytes of the dictionary into.
+// returns: Bytes of the dictionary, which have been allocated memory.
+//
+uint8_t *shared_train(char **paths, uint32_t n, uint32_t size, uint32_t *len) {
+  // Read the samples one after another, with room for the last hash to
+  // load a whole word
+  uint8_t *samples = (uint8_t *)calloc(SHARED_SAMPLES + 8, 1);
+  uint64_t *ends = (uint64_t *)malloc((n + 1) * sizeof(uint64_t));
+  uint32_t *count = (uint32_t *)calloc(1 << DMER_BITS, sizeof(uint32_t));
+  uint32_t *seen = (uint32_t *)calloc(1 << DMER_BITS, sizeof(uint32_t));
+  uint8_t *dict = (uint8_t *)malloc(size);
+  if (!samples || !ends || !count || !seen || !dict) {
+    printf("Error: Failed to allocate memory for dictionary training!\n");
+    exit(EXIT_FAILURE);
+  }
+  uint64_t total = 0;
+  uint32_t nsamples = 0;
+  while (nsamples < n && total < SHARED_SAMPLES) {
+    uint64_t file_size = 0;
+    total += read_file(paths[nsamples], samples + total,
+        SHARED_SAMPLES - total, &file_size);
+    ends[nsamples++] = total;
+  }
+
+  // A dictionary as large as the samples is just the samples
+  *len = 0;
+  if (total <= size) {
+    memcpy(dict, samples, total);
+    *len = total;
+  } else {
+    // Count the number of samples each substring occurs in, which is what
+    // a dictionary shared between them can save on
+    uint64_t start = 0;
+    for (uint32_t s = 0; s < nsamples; s++) {
+      for (uint64_t p = start; p + SHARED_DMER <= ends[s]; p++) {
+        uint32_t h = dmer_hash(samples + p);
+        if (seen[h] != s + 1) {
+          seen[h] = s + 1;
+          count[h]++;
+        }
+      }
+      start = ends[s];
+    }
+
+    // Take the best segment of each stretch, where a segment scores the
+    // counts of its substrings that occur in more than one sample
+    uint32_t seg = size < SHARED_SEGMENT ? size : SHARED_SEGMENT;
+    uint64_t stretch = total / (size / seg);
+    stretch = stretch < seg ? seg : stretch;
+    for (uint64_t lo = 0; lo + seg <= total && *len + seg <= size;
+         lo += stretch) {
+      uint64_t hi = lo + stretch < total ? lo + stretch : total;
+      uint64_t score = 0;
+      for (uint64_t p = lo; p + SHARED_DMER <= lo + seg; p++) {
+        uint32_t c = count[dmer_hash(samples + p)];
+        score += c > 1 ? c : 0;
+      }
+      // Slide the segment along the stretch a byte at a time
+      uint64_t best = score;
+      uint64_t best_pos = lo;
+      for (uint64_t p = lo + 1; p + seg <= hi; p++) {
+        uint32_t in = count[dmer_hash(samples + p + seg - SHARED_DMER)];
+        uint32_t out = count[dmer_hash(samples + p - 1)];
+        score += in > 1 ? in : 0;
+        score -= out > 1 ? out : 0;
+        if (score > best) {
+          best = score;
+          best_pos = p;
+        }
+      }
+      if (best == 0) {
+        continue;
+      }
+      for (uint64_t p = best_pos; p + SHARED_DMER <= best_pos + seg; p++) {
+        count[dmer_hash(samples + p)] = 0;
+      }
+      memcpy(dict + *len, samples + best_pos, seg);
+      *len += seg;
+    }
+  }
+  if (*len == 0) {
+    printf("Error: Samples have nothing in common to train a dictionary on!\n");
+    exit(EXIT_FAILURE);
+  }
+
+  free(samples);
+  free(ends);
+  free(count);
+  free(seen);
+  return dict;
+}
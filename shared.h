@@ -0,0 +1,61 @@
+#ifndef __SHARED_H__
+#define __SHARED_H__
+
+#include <inttypes.h>
+
+//
+// Largest number of bytes of a shared dictionary, and the number of bytes
+// of a trained one unless another size is asked for.
+//
+#define SHARED_MAX (1 << 20)
+#define SHARED_SIZE (16 << 10)
+
+//
+// Largest number of bytes of the samples a dictionary is trained on, later
+// files are left out.
+//
+#define SHARED_SAMPLES (64 << 20)
+
+//
+// Number of bytes of the segments a trained dictionary is made of, and of
+// the substrings that segments are scored by.
+//
+#define SHARED_SEGMENT 128
+#define SHARED_DMER 6
+
+//
+// Reads a shared dictionary from a file, exiting if it can't be read or is
+// larger than SHARED_MAX.
+//
+// path:    Path of the dictionary.
+// len:     Pointer to store the number of bytes of the dictionary into.
+// returns: Bytes of the dictionary, which have been allocated memory.
+//
+uint8_t *shared_load(const char *path, uint32_t *len);
+
+//
+// Writes a shared dictionary to a file, exiting if it can't be written.
+//
+// path:    Path of the dictionary.
+// dict:    Bytes of the dictionary.
+// len:     Number of bytes of the dictionary.
+// returns: Void.
+//
+void shared_save(const char *path, const uint8_t *dict, uint32_t len);
+
+//
+// Trains a shared dictionary from sample files. The samples are cut into
+// as many stretches as the dictionary has segments, and from each the
+// segment whose substrings of SHARED_DMER bytes occur in the most samples
+// is taken. The substrings of a segment that is taken no longer count, so
+// later segments cover what it doesn't.
+//
+// paths:   Paths of the sample files.
+// n:       Number of paths.
+// size:    Largest number of bytes of the dictionary.
+// len:     Pointer to store the number of bytes of the dictionary into.
+// returns: Bytes of the dictionary, which have been allocated memory.
+//
+uint8_t *shared_train(char **paths, uint32_t n, uint32_t size, uint32_t *len);
+
+#endif
@@ -0,0 +1,293 @@
+#include "stats.h"
+#include "codec.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+
+//
+// Constructor for CodecStats with every counter at zero.
+//
+// returns: Pointer to CodecStats that have been allocated memory.
+//
+CodecStats *stats_create(void) {
+  CodecStats *s = (CodecStats *)calloc(1, sizeof(CodecStats));
+  if (!s) {
+    printf("Error: Failed to allocate memory for CodecStats!\n");
+    exit(EXIT_FAILURE);
+  }
+  return s;
+}
+
+//
+// Destructor for CodecStats.
+//
+// s:       CodecStats to free allocated memory for.
+// returns: Void.
+//
+void stats_delete(CodecStats *s) {
+  free(s);
+  return;
+}
+
+//
+// Reads the wall clock and the CPU clock of the calling thread.
+//
+// now:     Clock to store the time into.
+// returns: Void.
+//
+void clock_now(Clock *now) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  now->wall = ts.tv_sec * 1000000000ull + ts.tv_nsec;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  now->cpu = ts.tv_sec * 1000000000ull + ts.tv_nsec;
+  return;
+}
+
+//
+// Adds the time since start to a phase.
+//
+// phase:   Clock of the phase to add to.
+// start:   Time the phase started at, from clock_now().
+// returns: Void.
+//
+void clock_add(Clock *phase, Clock *start) {
+  Clock now;
+  clock_now(&now);
+  phase->wall += now.wall - start->wall;
+  phase->cpu += now.cpu - start->cpu;
+  return;
+}
+
+//
+// Takes time that a nested phase has gained since a snapshot of it out of
+// a phase, so that time is only counted once.
+//
+// phase:   Clock of the phase to take the time out of.
+// nested:  Clock of the nested phase.
+// before:  Snapshot of the nested phase when the outer phase started.
+// returns: Void.
+//
+void clock_exclude(Clock *phase, Clock *nested, Clock *before) {
+  phase->wall -= nested->wall - before->wall;
+  phase->cpu -= nested->cpu - before->cpu;
+  return;
+}
+
+//
+// Adds the counters of one set of CodecStats to another, keeping the larger of
+// the peaks. Times of CodecStats from several threads add up to thread time.
+//
+// s:       CodecStats to add to.
+// other:   CodecStats to add.
+// returns: Void.
+//
+void stats_merge(CodecStats *s, CodecStats *other) {
+  Clock *to[] = { &s->read, &s->dict, &s->pack, &s->write };
+  Clock *from[] = { &other->read, &other->dict, &other->pack, &other->write };
+  for (int i = 0; i < 4; i++) {
+    to[i]->wall += from[i]->wall;
+    to[i]->cpu += from[i]->cpu;
+  }
+  s->phrases += other->phrases;
+  s->phrase_syms += other->phrase_syms;
+  if (other->max_phrase > s->max_phrase) {
+    s->max_phrase = other->max_phrase;
+  }
+  if (other->peak_entries > s->peak_entries) {
+    s->peak_entries = other->peak_entries;
+  }
+  if (other->peak_bytes > s->peak_bytes) {
+    s->peak_bytes = other->peak_bytes;
+  }
+  return;
+}
+
+//
+// Prints one phase as its wall and CPU time and its share of the run.
+//
+// name:    Name of the phase.
+// phase:   Time of the phase.
+// total:   Time the whole run took.
+// returns: Void.
+//
+static void phase_print(const char *name, Clock *phase, Clock *total) {
+  printf("  %-16s %10.3f ms wall %10.3f ms CPU %6.1f%%\n", name,
+      phase->wall / 1e6, phase->cpu / 1e6,
+      total->wall ? 100.0 * phase->wall / total->wall : 0);
+  return;
+}
+
+//
+// Prints CodecStats along with the totals of a run.
+//
+// s:       CodecStats to print.
+// total:   Time the whole run took.
+// syms:    Number of uncompressed bytes.
+// resets:  Number of times the dictionary was reset.
+// returns: Void.
+//
+void stats_print(CodecStats *s, Clock *total, uint64_t syms, uint64_t resets) {
+  printf("Phases:\n");
+  phase_print("Read", &s->read, total);
+  phase_print("Dictionary", &s->dict, total);
+  phase_print("Bit packing", &s->pack, total);
+  phase_print("Write", &s->write, total);
+  phase_print("Total", total, total);
+  printf("Dictionary resets: %lu\n", resets);
+  printf("Phrases: %lu\n", s->phrases);
+  printf("Average phrase length: %.2lf\n",
+      s->phrases ? (double)s->phrase_syms / s->phrases : 0);
+  printf("Maximum phrase length: %u\n", s->max_phrase);
+  printf("Dictionary entries at peak: %u\n", s->peak_entries);
+  printf("Dictionary bytes at peak: %lu\n", s->peak_bytes);
+  printf("Throughput: %.2lf MB/s\n",
+      total->wall ? syms * 1e3 / total->wall : 0);
+  return;
+}
+
+//
+// Starts tracing the dictionary of a Codec into a file as CSV, with a
+// sample once every so many phrases.
+//
+// s:       CodecStats to trace with.
+// trace:   File to write the samples to.
+// every:   Number of phrases between two samples.
+// encode:  True if tracing an encoder, false for a decoder.
+// returns: Void.
+//
+void stats_trace_start(CodecStats *s, FILE *trace, uint64_t every,
+    bool encode) {
+  s->trace = trace;
+  s->trace_every = every;
+  s->trace_left = every;
+  s->trace_hist = !encode;
+  fprintf(trace, "phrases,syms,next_code,bit_length,mean_phrase,"
+                 "bits_per_byte,resets%s\n", encode ? "" : ",hist_bytes");
+  return;
+}
+
+//
+// Writes a trace sample of the phrases since the last one: the next code
+// and the number of bits it takes, the mean phrase length and the pair bits
+// per input byte of the window, and for a decoder the size of its history.
+//
+// s:         CodecStats to trace with.
+// next_code: Next code of the dictionary.
+// bit_len:   Number of bits the next code is packed into.
+// resets:    Number of dictionary resets so far.
+// hist_len:  Number of bytes in the history of a WordTable.
+// returns:   Void.
+//
+void stats_trace(CodecStats *s, uint32_t next_code, uint8_t bit_len,
+    uint64_t resets, uint64_t hist_len) {
+  fprintf(s->trace, "%lu,%lu,%u,%u,%.3f,%.4f,%lu", s->phrases,
+      s->phrase_syms, next_code, bit_len,
+      (double)s->window_syms / s->trace_every,
+      s->window_syms ? (double)s->window_bits / s->window_syms : 0, resets);
+  if (s->trace_hist) {
+    fprintf(s->trace, ",%lu", hist_len);
+  }
+  fprintf(s->trace, "\n");
+  s->trace_left = s->trace_every;
+  s->window_syms = 0;
+  s->window_bits = 0;
+  return;
+}
+
+//
+// Writes the metrics of a run to a file as one JSON object, or as a
+// Prometheus textfile if the path ends in ".prom". The file is written
+// under a temporary name and renamed, so a scraper never reads half of it.
+//
+// c:       Codec of the run, with CodecStats.
+// path:    Path of the file to write.
+// encode:  True if the run compressed, false if it decompressed.
+// total:   Time the whole run took.
+// returns: Void.
+//
+void stats_export(struct Codec *c, const char *path, bool encode,
+    Clock *total) {
+  CodecStats *s = c->stats;
+  uint64_t compressed = (c->total_bits + 7) / 8;
+  uint64_t bytes_in = encode ? c->total_syms : compressed;
+  uint64_t bytes_out = encode ? compressed : c->total_syms;
+
+  // CPU time and peak memory of the whole process, all threads included
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  double cpu = usage.ru_utime.tv_sec + usage.ru_stime.tv_sec
+               + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+  uint64_t peak_rss = (uint64_t)usage.ru_maxrss * 1024;
+
+  const char *counts[] = { "bytes_in", "bytes_out", "total_bits", "resets",
+    "phrases", "peak_rss_bytes" };
+  const char *count_help[] = { "Bytes read by the run.",
+    "Bytes written by the run.", "Bits of the compressed stream.",
+    "Dictionary resets.", "Phrases coded.",
+    "Peak resident memory of the process in bytes." };
+  uint64_t count_values[] = { bytes_in, bytes_out, c->total_bits, c->resets,
+    s->phrases, peak_rss };
+  const char *count_names[] = { "bytes_in_total", "bytes_out_total",
+    "bits_total", "resets_total", "phrases_total", "peak_rss_bytes" };
+  bool count_totals[] = { true, true, true, true, true, false };
+  const char *times[] = { "wall_seconds", "cpu_seconds", "read_seconds",
+    "dict_seconds", "pack_seconds", "write_seconds" };
+  const char *time_help[] = { "Wall time of the run.",
+    "CPU time of the process, all threads included.",
+    "Wall time spent reading.", "Wall time spent in the dictionary.",
+    "Wall time spent packing bits.", "Wall time spent writing." };
+  double time_values[] = { total->wall / 1e9, cpu, s->read.wall / 1e9,
+    s->dict.wall / 1e9, s->pack.wall / 1e9, s->write.wall / 1e9 };
+  int ncounts = sizeof(counts) / sizeof(counts[0]);
+  int ntimes = sizeof(times) / sizeof(times[0]);
+
+  char tmp[4096];
+  if (snprintf(tmp, sizeof(tmp), "%s.tmp", path) >= (int)sizeof(tmp)) {
+    printf("Error: Metrics path is too long!\n");
+    exit(EXIT_FAILURE);
+  }
+  FILE *f = fopen(tmp, "w");
+  if (!f) {
+    printf("Error: Failed to open metrics file!\n");
+    exit(EXIT_FAILURE);
+  }
+
+  const char *tool = encode ? "encode" : "decode";
+  size_t len = strlen(path);
+  if (len >= 5 && strcmp(path + len - 5, ".prom") == 0) {
+    // Totals are counters with the _total suffix, only the peak memory,
+    // a level rather than a sum, is a gauge
+    for (int i = 0; i < ncounts; i++) {
+      fprintf(f, "# HELP lzc_%s %s\n", count_names[i], count_help[i]);
+      fprintf(f, "# TYPE lzc_%s %s\n", count_names[i],
+          count_totals[i] ? "counter" : "gauge");
+      fprintf(f, "lzc_%s{tool=\"%s\",version=\"%s\"} %lu\n",
+          count_names[i], tool, CODEC_VERSION, count_values[i]);
+    }
+    for (int i = 0; i < ntimes; i++) {
+      fprintf(f, "# HELP lzc_%s_total %s\n", times[i], time_help[i]);
+      fprintf(f, "# TYPE lzc_%s_total counter\n", times[i]);
+      fprintf(f, "lzc_%s_total{tool=\"%s\",version=\"%s\"} %.6f\n",
+          times[i], tool, CODEC_VERSION, time_values[i]);
+    }
+  } else {
+    fprintf(f, "{\"tool\":\"%s\",\"version\":\"%s\"", tool,
+        CODEC_VERSION);
+    for (int i = 0; i < ncounts; i++) {
+      fprintf(f, ",\"%s\":%lu", counts[i], count_values[i]);
+    }
+    for (int i = 0; i < ntimes; i++) {
+      fprintf(f, ",\"%s\":%.6f", times[i], time_values[i]);
+    }
+    fprintf(f, "}\n");
+  }
+
+  if (fclose(f) != 0 || rename(tmp, path) != 0) {
+    printf("Error: Failed to write metrics file!\n");
+    exit(EXIT_FAILURE);
+  }
+  return;
+}
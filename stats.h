@@ -0,0 +1,172 @@
+#ifndef __STATS_H__
+#define __STATS_H__
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+//
+// Version of the codec reported in exported metrics.
+//
+#define CODEC_VERSION "1.0"
+
+struct Codec;
+
+//
+// Struct definition of a Clock, an amount of time or a point in time.
+//
+// wall:    Nanoseconds of wall time.
+// cpu:     Nanoseconds of CPU time of the calling thread.
+//
+typedef struct Clock {
+  uint64_t wall;
+  uint64_t cpu;
+} Clock;
+
+//
+// Struct definition of CodecStats, what a Codec measures when -v is given.
+// The phases don't overlap, reading and writing done inside a phase is
+// taken out of it and counted in the read and write phases instead.
+//
+// read:          Time spent reading input.
+// dict:          Time spent in the dictionary, matching phrases when
+//                compressing or appending words when decompressing.
+// pack:          Time spent packing pairs into bits, or unpacking them.
+// write:         Time spent writing output.
+// phrases:       Number of phrases compressed or decompressed.
+// phrase_syms:   Number of symbols in those phrases.
+// max_phrase:    Number of symbols in the longest phrase.
+// peak_entries:  Most phrases the dictionary held at once.
+// peak_bytes:    Most bytes the dictionary took up at once.
+// trace:         File to write trace samples to, NULL to not trace.
+// trace_every:   Number of phrases between two trace samples.
+// trace_left:    Number of phrases until the next trace sample.
+// trace_hist:    True if samples include the size of the history.
+// window_syms:   Number of symbols since the last trace sample.
+// window_bits:   Number of pair bits since the last trace sample.
+//
+typedef struct CodecStats {
+  Clock read;
+  Clock dict;
+  Clock pack;
+  Clock write;
+  uint64_t phrases;
+  uint64_t phrase_syms;
+  uint32_t max_phrase;
+  uint32_t peak_entries;
+  uint64_t peak_bytes;
+  FILE *trace;
+  uint64_t trace_every;
+  uint64_t trace_left;
+  bool trace_hist;
+  uint64_t window_syms;
+  uint64_t window_bits;
+} CodecStats;
+
+//
+// Constructor for CodecStats with every counter at zero.
+//
+// returns: Pointer to CodecStats that have been allocated memory.
+//
+CodecStats *stats_create(void);
+
+//
+// Destructor for CodecStats.
+//
+// s:       CodecStats to free allocated memory for.
+// returns: Void.
+//
+void stats_delete(CodecStats *s);
+
+//
+// Reads the wall clock and the CPU clock of the calling thread.
+//
+// now:     Clock to store the time into.
+// returns: Void.
+//
+void clock_now(Clock *now);
+
+//
+// Adds the time since start to a phase.
+//
+// phase:   Clock of the phase to add to.
+// start:   Time the phase started at, from clock_now().
+// returns: Void.
+//
+void clock_add(Clock *phase, Clock *start);
+
+//
+// Takes time that a nested phase has gained since a snapshot of it out of
+// a phase, so that time is only counted once.
+//
+// phase:   Clock of the phase to take the time out of.
+// nested:  Clock of the nested phase.
+// before:  Snapshot of the nested phase when the outer phase started.
+// returns: Void.
+//
+void clock_exclude(Clock *phase, Clock *nested, Clock *before);
+
+//
+// Adds the counters of one set of CodecStats to another, keeping the larger of
+// the peaks. Times of CodecStats from several threads add up to thread time.
+//
+// s:       CodecStats to add to.
+// other:   CodecStats to add.
+// returns: Void.
+//
+void stats_merge(CodecStats *s, CodecStats *other);
+
+//
+// Prints CodecStats along with the totals of a run.
+//
+// s:       CodecStats to print.
+// total:   Time the whole run took.
+// syms:    Number of uncompressed bytes.
+// resets:  Number of times the dictionary was reset.
+// returns: Void.
+//
+void stats_print(CodecStats *s, Clock *total, uint64_t syms, uint64_t resets);
+
+//
+// Starts tracing the dictionary of a Codec into a file as CSV, with a
+// sample once every so many phrases.
+//
+// s:       CodecStats to trace with.
+// trace:   File to write the samples to.
+// every:   Number of phrases between two samples.
+// encode:  True if tracing an encoder, false for a decoder.
+// returns: Void.
+//
+void stats_trace_start(CodecStats *s, FILE *trace, uint64_t every,
+    bool encode);
+
+//
+// Writes a trace sample of the phrases since the last one: the next code
+// and the number of bits it takes, the mean phrase length and the pair bits
+// per input byte of the window, and for a decoder the size of its history.
+//
+// s:         CodecStats to trace with.
+// next_code: Next code of the dictionary.
+// bit_len:   Number of bits the next code is packed into.
+// resets:    Number of dictionary resets so far.
+// hist_len:  Number of bytes in the history of a WordTable.
+// returns:   Void.
+//
+void stats_trace(CodecStats *s, uint32_t next_code, uint8_t bit_len,
+    uint64_t resets, uint64_t hist_len);
+
+//
+// Writes the metrics of a run to a file as one JSON object, or as a
+// Prometheus textfile if the path ends in ".prom". The file is written
+// under a temporary name and renamed, so a scraper never reads half of it.
+//
+// c:       Codec of the run, with CodecStats.
+// path:    Path of the file to write.
+// encode:  True if the run compressed, false if it decompressed.
+// total:   Time the whole run took.
+// returns: Void.
+//
+void stats_export(struct Codec *c, const char *path, bool encode,
+    Clock *total);
+
+#endif
@@ -1,89 +1,82 @@
 #include "trie.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 //
 // Constructor for a TrieNode.
+// The TrieNode is taken from the arena of the Trie and cleared.
 //
+// t:       Trie to take the TrieNode from.
 // index:   Index of the constructed TrieNode.
-// returns: Pointer to a TrieNode that has been allocated memory.
+// returns: Pointer to a TrieNode from the arena.
 //
-TrieNode *trie_node_create(uint16_t index) {
-  TrieNode *new_node = (TrieNode *)calloc(1, sizeof(TrieNode));
-
-  // Error check if memory allocation failed
-  if (!new_node) {
-    printf("Error: Failed to allocate memory for TrieNode!\n");
+TrieNode *trie_node_create(Trie *t, uint16_t index) {
+  // Error check if the arena ran out of nodes
+  if (t->used == MAX_CODE) {
+    printf("Error: Ran out of TrieNodes in the arena!\n");
     exit(EXIT_FAILURE);
   }
 
+  // Take the next node from the arena, a node handed out before a reset
+  // still has its old children so it must be cleared
+  TrieNode *new_node = &t->arena[t->used];
+  t->used++;
+  memset(new_node->children, 0, sizeof(new_node->children));
+
   // Set the code for the node
   new_node->code = index;
   return new_node;
 }
 
-//
-// Destructor for a TrieNode.
-//
-// n:       TrieNode to free allocated memory for.
-// returns: Void.
-//
-void trie_node_delete(TrieNode *n) {
-  free(n);
-  return;
-}
-
 //
 // Initializes a Trie: a root TrieNode with the index EMPTY_CODE.
 //
-// returns: Pointer to the root of a Trie.
+// returns: Pointer to a Trie.
 //
-TrieNode *trie_create(void) {
-  // Allocate memory for the root node
-  TrieNode *root = trie_node_create(EMPTY_CODE);
-  return root;
+Trie *trie_create(void) {
+  Trie *t = (Trie *)calloc(1, sizeof(Trie));
+  if (!t) {
+    printf("Error: Failed to allocate memory for Trie!\n");
+    exit(EXIT_FAILURE);
+  }
+
+  // Allocate memory for every node up front, pages are only touched once a
+  // node is handed out
+  t->arena = (TrieNode *)calloc(MAX_CODE, sizeof(TrieNode));
+  if (!t->arena) {
+    printf("Error: Failed to allocate memory for TrieNode arena!\n");
+    exit(EXIT_FAILURE);
+  }
+
+  // The root node is the first node in the arena
+  t->root = trie_node_create(t, EMPTY_CODE);
+  return t;
 }
 
 //
 // Resets a Trie to just the root TrieNode.
+// The arena is rewound, so no TrieNode is freed.
 //
-// root:    Root of the Trie to reset.
+// t:       Trie to reset.
 // returns: Void.
 //
-void trie_reset(TrieNode *root) {
-  // Loop to reset all the children the in node
-  for (int i = 0; i < ALPHABET; i++) {
-    // Check if the child even exists
-    if (root->children[i]) {
-      // Call destructor to deallocate memory for child and all of its
-      // children
-      trie_delete(root->children[i]);
-      // Set the child node to null
-      root->children[i] = NULL;
-    }
-  }
+void trie_reset(Trie *t) {
+  // Rewind the arena to just past the root and clear the root's children
+  t->used = 1;
+  memset(t->root->children, 0, sizeof(t->root->children));
   return;
 }
 
 //
-// Deletes a sub-Trie starting from the sub-Trie's root.
+// Deletes a Trie and the arena of all its TrieNodes.
 //
-// n:       Root of the sub-Trie to delete.
+// t:       Trie to delete.
 // returns: Void.
 //
-void trie_delete(TrieNode *n) {
-  //Check if node being passed exists
-  if (n) {
-    // Loop to deallocate memory for all the children in node
-    for (int i = 0; i < ALPHABET; i++) {
-      // recursively call itself to deallocate the memory of the childrens
-      // children
-      trie_delete(n->children[i]);
-    }
-    // Call destructor to free memory
-    trie_node_delete(n);
-    n = NULL;
-  }
+void trie_delete(Trie *t) {
+  free(t->arena);
+  free(t);
   return;
 }
 
@@ -19,43 +19,53 @@ struct TrieNode {
 };
 
 //
-// Constructor for a TrieNode.
-//
-// index:   Index of the constructed TrieNode.
-// returns: Pointer to a TrieNode that has been allocated memory.
-//
-TrieNode *trie_node_create(uint16_t index);
+// Struct definition of a Trie.
+// Every TrieNode of a Trie comes from a single preallocated arena.
+// There is at most one TrieNode per code, so the arena holds MAX_CODE nodes.
+//
+// root:  Root TrieNode with the code EMPTY_CODE, the first node in the arena.
+// arena: Array of MAX_CODE TrieNodes to hand out.
+// used:  Number of TrieNodes handed out from the arena, including the root.
+//
+typedef struct Trie {
+  TrieNode *root;
+  TrieNode *arena;
+  uint32_t used;
+} Trie;
 
 //
-// Destructor for a TrieNode.
+// Constructor for a TrieNode.
+// The TrieNode is taken from the arena of the Trie and cleared.
 //
-// n:       TrieNode to free allocated memory for.
-// returns: Void.
+// t:       Trie to take the TrieNode from.
+// index:   Index of the constructed TrieNode.
+// returns: Pointer to a TrieNode from the arena.
 //
-void trie_node_delete(TrieNode *n);
+TrieNode *trie_node_create(Trie *t, uint16_t index);
 
 //
 // Initializes a Trie: a root TrieNode with the index EMPTY_CODE.
 //
-// returns: Pointer to the root of a Trie.
+// returns: Pointer to a Trie.
 //
-TrieNode *trie_create(void);
+Trie *trie_create(void);
 
 //
 // Resets a Trie to just the root TrieNode.
+// The arena is rewound, so no TrieNode is freed.
 //
-// root:    Root of the Trie to reset.
+// t:       Trie to reset.
 // returns: Void.
 //
-void trie_reset(TrieNode *root);
+void trie_reset(Trie *t);
 
 //
-// Deletes a sub-Trie starting from the sub-Trie's root.
+// Deletes a Trie and the arena of all its TrieNodes.
 //
-// n:       Root of the sub-Trie to delete.
+// t:       Trie to delete.
 // returns: Void.
 //
-void trie_delete(TrieNode *n);
+void trie_delete(Trie *t);
 
 //
 // Returns a pointer to the child TrieNode reprsenting the symbol sym.
@@ -0,0 +1,281 @@
+#include "uring.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>) \
+    && !defined(NO_URING)
+#include <errno.h>
+#include <linux/io_uring.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+//
+// Struct definition of a Uring, the rings an io_uring shares with the
+// kernel. Reads and writes are queued as entries of the submission ring,
+// which the kernel takes from its head, and completed as entries of the
+// completion ring, which it adds at its tail.
+//
+// fd:        File descriptor of the io_uring.
+// sq_head:   Head of the submission ring, moved by the kernel.
+// sq_tail:   Tail of the submission ring, moved by the Uring.
+// sq_mask:   Mask of the index of an entry of the submission ring.
+// sq_array:  Indexes of the submission entries in the submission ring.
+// sqes:      Submission entries.
+// cq_head:   Head of the completion ring, moved by the Uring.
+// cq_tail:   Tail of the completion ring, moved by the kernel.
+// cq_mask:   Mask of the index of an entry of the completion ring.
+// cqes:      Completion entries.
+// sq_ring:   Mapping of the submission ring.
+// sq_len:    Number of bytes of the mapping of the submission ring.
+// cq_ring:   Mapping of the completion ring.
+// cq_len:    Number of bytes of the mapping of the completion ring.
+// sqes_len:  Number of bytes of the mapping of the submission entries.
+// queued:    Number of entries queued since the last submission.
+//
+struct Uring {
+  int fd;
+  uint32_t *sq_head;
+  uint32_t *sq_tail;
+  uint32_t *sq_mask;
+  uint32_t *sq_array;
+  struct io_uring_sqe *sqes;
+  uint32_t *cq_head;
+  uint32_t *cq_tail;
+  uint32_t *cq_mask;
+  struct io_uring_cqe *cqes;
+  void *sq_ring;
+  size_t sq_len;
+  void *cq_ring;
+  size_t cq_len;
+  size_t sqes_len;
+  uint32_t queued;
+};
+
+//
+// Constructor for a Uring, with room for entries reads and writes in
+// flight. The buffer all of them go to or come from is registered with the
+// kernel once, so it isn't mapped again for every read and write.
+//
+// entries: Largest number of reads and writes in flight.
+// buf:     Buffer to register.
+// len:     Number of bytes of the buffer.
+// returns: Pointer to a Uring that has been allocated memory, NULL if the
+//          kernel has no io_uring or doesn't allow it.
+//
+Uring *uring_create(uint32_t entries, uint8_t *buf, uint64_t len) {
+  struct io_uring_params params;
+  memset(&params, 0, sizeof(params));
+  int fd = syscall(__NR_io_uring_setup, entries, &params);
+  if (fd < 0) {
+    return NULL;
+  }
+
+  Uring *u = (Uring *)calloc(1, sizeof(Uring));
+  if (!u) {
+    printf("Error: Failed to allocate memory for Uring!\n");
+    exit(EXIT_FAILURE);
+  }
+  u->fd = fd;
+  u->sq_len = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+  u->cq_len = params.cq_off.cqes
+              + params.cq_entries * sizeof(struct io_uring_cqe);
+  u->sqes_len = params.sq_entries * sizeof(struct io_uring_sqe);
+  u->sq_ring = mmap(NULL, u->sq_len, PROT_READ | PROT_WRITE,
+      MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+  u->cq_ring = mmap(NULL, u->cq_len, PROT_READ | PROT_WRITE,
+      MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+  u->sqes = (struct io_uring_sqe *)mmap(NULL, u->sqes_len,
+      PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+
+  // A buffer that can't be registered, say for the limit of locked memory,
+  // is left to read() and write() like a kernel with no io_uring
+  struct iovec iov = { buf, len };
+  if (u->sq_ring == MAP_FAILED || u->cq_ring == MAP_FAILED
+      || u->sqes == MAP_FAILED
+      || syscall(__NR_io_uring_register, fd, IORING_REGISTER_BUFFERS, &iov, 1)
+             < 0) {
+    uring_delete(u);
+    return NULL;
+  }
+
+  uint8_t *sq = (uint8_t *)u->sq_ring;
+  uint8_t *cq = (uint8_t *)u->cq_ring;
+  u->sq_head = (uint32_t *)(sq + params.sq_off.head);
+  u->sq_tail = (uint32_t *)(sq + params.sq_off.tail);
+  u->sq_mask = (uint32_t *)(sq + params.sq_off.ring_mask);
+  u->sq_array = (uint32_t *)(sq + params.sq_off.array);
+  u->cq_head = (uint32_t *)(cq + params.cq_off.head);
+  u->cq_tail = (uint32_t *)(cq + params.cq_off.tail);
+  u->cq_mask = (uint32_t *)(cq + params.cq_off.ring_mask);
+  u->cqes = (struct io_uring_cqe *)(cq + params.cq_off.cqes);
+  return u;
+}
+
+//
+// Destructor for a Uring. Every read and write must have completed.
+//
+// u:       Uring to free allocated memory for.
+// returns: Void.
+//
+void uring_delete(Uring *u) {
+  if (u->sqes && u->sqes != MAP_FAILED) {
+    munmap(u->sqes, u->sqes_len);
+  }
+  if (u->cq_ring && u->cq_ring != MAP_FAILED) {
+    munmap(u->cq_ring, u->cq_len);
+  }
+  if (u->sq_ring && u->sq_ring != MAP_FAILED) {
+    munmap(u->sq_ring, u->sq_len);
+  }
+  close(u->fd);
+  free(u);
+  return;
+}
+
+//
+// Queues a read or a write of the registered buffer as the next entry of
+// the submission ring. The kernel only reads the tail once it is entered,
+// so the entry has to be complete before the tail is moved past it.
+//
+// u:       Uring to queue on.
+// op:      IORING_OP_READ_FIXED or IORING_OP_WRITE_FIXED.
+// fd:      File descriptor to read from or write to.
+// buf:     Part of the registered buffer.
+// len:     Number of bytes.
+// offset:  Offset in the file.
+// tag:     Value that uring_wait() returns with the completion.
+// returns: Void.
+//
+static void uring_queue(Uring *u, uint8_t op, int fd, const uint8_t *buf,
+    uint32_t len, uint64_t offset, uint64_t tag) {
+  uint32_t tail = *u->sq_tail;
+  uint32_t index = tail & *u->sq_mask;
+  struct io_uring_sqe *sqe = &u->sqes[index];
+  memset(sqe, 0, sizeof(*sqe));
+  sqe->opcode = op;
+  sqe->fd = fd;
+  sqe->addr = (uint64_t)(uintptr_t)buf;
+  sqe->len = len;
+  sqe->off = offset;
+  sqe->buf_index = 0;
+  sqe->user_data = tag;
+  u->sq_array[index] = index;
+  __atomic_store_n(u->sq_tail, tail + 1, __ATOMIC_RELEASE);
+  u->queued++;
+  return;
+}
+
+//
+// Queues a read into the registered buffer, which is submitted by the next
+// call to uring_wait().
+//
+// u:       Uring to queue the read on.
+// fd:      File descriptor to read from.
+// buf:     Part of the registered buffer to read into.
+// len:     Number of bytes to read.
+// offset:  Offset in the file to read from.
+// tag:     Value that uring_wait() returns with the completion.
+// returns: Void.
+//
+void uring_read(Uring *u, int fd, uint8_t *buf, uint32_t len, uint64_t offset,
+    uint64_t tag) {
+  uring_queue(u, IORING_OP_READ_FIXED, fd, buf, len, offset, tag);
+  return;
+}
+
+//
+// Queues a write from the registered buffer, which is submitted by the next
+// call to uring_wait().
+//
+// u:       Uring to queue the write on.
+// fd:      File descriptor to write to.
+// buf:     Part of the registered buffer to write out.
+// len:     Number of bytes to write.
+// offset:  Offset in the file to write to.
+// tag:     Value that uring_wait() returns with the completion.
+// returns: Void.
+//
+void uring_write(Uring *u, int fd, const uint8_t *buf, uint32_t len,
+    uint64_t offset, uint64_t tag) {
+  uring_queue(u, IORING_OP_WRITE_FIXED, fd, buf, len, offset, tag);
+  return;
+}
+
+//
+// Submits the queued reads and writes and waits for one of those in flight
+// to complete.
+//
+// u:       Uring to wait on.
+// tag:     Pointer to store the tag of the completed read or write into.
+// returns: Number of bytes read or written, or a negative errno.
+//
+int32_t uring_wait(Uring *u, uint64_t *tag) {
+  uint32_t head = *u->cq_head;
+  while (u->queued || head == __atomic_load_n(u->cq_tail, __ATOMIC_ACQUIRE)) {
+    int n = syscall(__NR_io_uring_enter, u->fd, u->queued, 1,
+        IORING_ENTER_GETEVENTS, NULL, 0);
+    if (n < 0 && errno != EINTR) {
+      printf("Error: Failed to enter io_uring!\n");
+      exit(EXIT_FAILURE);
+    }
+    u->queued -= n > 0 ? n : 0;
+  }
+  struct io_uring_cqe *cqe = &u->cqes[head & *u->cq_mask];
+  int32_t res = cqe->res;
+  *tag = cqe->user_data;
+  __atomic_store_n(u->cq_head, head + 1, __ATOMIC_RELEASE);
+  return res;
+}
+
+#else
+//
+// Without io_uring there is no Uring to create, and the rest is never
+// called.
+//
+struct Uring {
+  int fd;
+};
+
+Uring *uring_create(uint32_t entries, uint8_t *buf, uint64_t len) {
+  (void)entries;
+  (void)buf;
+  (void)len;
+  return NULL;
+}
+
+void uring_delete(Uring *u) {
+  free(u);
+  return;
+}
+
+void uring_read(Uring *u, int fd, uint8_t *buf, uint32_t len, uint64_t offset,
+    uint64_t tag) {
+  (void)u;
+  (void)fd;
+  (void)buf;
+  (void)len;
+  (void)offset;
+  (void)tag;
+  return;
+}
+
+void uring_write(Uring *u, int fd, const uint8_t *buf, uint32_t len,
+    uint64_t offset, uint64_t tag) {
+  (void)u;
+  (void)fd;
+  (void)buf;
+  (void)len;
+  (void)offset;
+  (void)tag;
+  return;
+}
+
+int32_t uring_wait(Uring *u, uint64_t *tag) {
+  (void)u;
+  *tag = 0;
+  return -1;
+}
+#endif
@@ -0,0 +1,76 @@
+#ifndef __URING_H__
+#define __URING_H__
+
+#include <inttypes.h>
+#include <stdbool.h>
+
+//
+// An io_uring of the kernel, a queue of reads and writes submitted at once
+// and completed in whatever order the device finishes them. It is only
+// built on Linux, and not with NO_URING defined, otherwise uring_create()
+// always fails.
+//
+typedef struct Uring Uring;
+
+//
+// Constructor for a Uring, with room for entries reads and writes in
+// flight. The buffer all of them go to or come from is registered with the
+// kernel once, so it isn't mapped again for every read and write.
+//
+// entries: Largest number of reads and writes in flight.
+// buf:     Buffer to register.
+// len:     Number of bytes of the buffer.
+// returns: Pointer to a Uring that has been allocated memory, NULL if the
+//          kernel has no io_uring or doesn't allow it.
+//
+Uring *uring_create(uint32_t entries, uint8_t *buf, uint64_t len);
+
+//
+// Destructor for a Uring. Every read and write must have completed.
+//
+// u:       Uring to free allocated memory for.
+// returns: Void.
+//
+void uring_delete(Uring *u);
+
+//
+// Queues a read into the registered buffer, which is submitted by the next
+// call to uring_wait().
+//
+// u:       Uring to queue the read on.
+// fd:      File descriptor to read from.
+// buf:     Part of the registered buffer to read into.
+// len:     Number of bytes to read.
+// offset:  Offset in the file to read from.
+// tag:     Value that uring_wait() returns with the completion.
+// returns: Void.
+//
+void uring_read(Uring *u, int fd, uint8_t *buf, uint32_t len, uint64_t offset,
+    uint64_t tag);
+
+//
+// Queues a write from the registered buffer, which is submitted by the next
+// call to uring_wait().
+//
+// u:       Uring to queue the write on.
+// fd:      File descriptor to write to.
+// buf:     Part of the registered buffer to write out.
+// len:     Number of bytes to write.
+// offset:  Offset in the file to write to.
+// tag:     Value that uring_wait() returns with the completion.
+// returns: Void.
+//
+void uring_write(Uring *u, int fd, const uint8_t *buf, uint32_t len,
+    uint64_t offset, uint64_t tag);
+
+//
+// Submits the queued reads and writes and waits for one of those in flight
+// to complete.
+//
+// u:       Uring to wait on.
+// tag:     Pointer to store the tag of the completed read or write into.
+// returns: Number of bytes read or written, or a negative errno.
+//
+int32_t uring_wait(Uring *u, uint64_t *tag);
+
+#endif
@@ -4,151 +4,127 @@
 #include <string.h>
 
 //
-// Constructor for a word.
-//
-// syms:    Array of symbols a Word represents.
-// len:     Length of the array of symbols.
-// returns: Pointer to a Word that has been allocated memory.
-//
-Word *word_create(uint8_t *syms, uint32_t len) {
-  // Allocate memory for word member
-  Word *word = (Word *)calloc(1, sizeof(Word));
-  if (!word) {
-    printf("Error: Failed to allocate memory for word struct!\n");
-    exit(EXIT_FAILURE);
-  }
-
-  // Allocate memory for symbol
-  word->syms = (uint8_t *)calloc(len, sizeof(uint8_t));
-  if (!word->syms) {
-    printf("Error: Failed to allocate memory for word sym!\n");
-    exit(EXIT_FAILURE);
-  }
-
-  // Copy the symbol over to the new word member
-  memcpy(word->syms, syms, len);
-  // Set the length of the symbol to the length being passed
-  word->len = len;
-  return word;
-}
-
-//
-// Constructs a new Word from the specified Word appended with a symbol.
+// Constructs a new Word from the Word of the specified code appended with a
+// symbol and stores it at next_code in the WordTable.
 // The Word specified to append to may be empty.
 // If the above is the case, the new Word should contain only the symbol.
 //
-// w:       Word to append to.
-// sym:     Symbol to append.
-// returns: New Word which represents the result of appending.
-//
-Word *word_append_sym(Word *w, uint8_t sym) {
-  // Check is the word being passed has a symbol
-  if (w->len) {
-    // Allocate a new word member
-    Word *word = (Word *)calloc(1, sizeof(Word));
-    if (!word) {
-      printf("Error: Failed to allocate memory for word struct!\n");
-      exit(EXIT_FAILURE);
+// wt:        WordTable that holds the Word to append to.
+// code:      Code of the Word to append to.
+// sym:       Symbol to append.
+// next_code: Code to store the new Word at.
+// returns:   New Word which represents the result of appending.
+//
+Word *word_append_sym(WordTable *wt, uint32_t code, uint8_t sym,
+    uint32_t next_code) {
+  Word *w = &wt->words[code];
+  Word *word = &wt->words[next_code];
+
+  // Double the history until the new word fits at the end of it
+  if (wt->hist_len + w->len + 1 > wt->hist_cap) {
+    while (wt->hist_len + w->len + 1 > wt->hist_cap) {
+      wt->hist_cap *= 2;
     }
-    // Allocates memory for new symbol with lenght + 1 elements
-    word->syms = (uint8_t *)calloc(w->len + 1, sizeof(uint8_t));
-    if (!word->syms) {
-      printf("Error: Failed to allocate memory for word syms!\n");
+    wt->hist = (uint8_t *)realloc(wt->hist, wt->hist_cap);
+    if (!wt->hist) {
+      printf("Error: Failed to allocate memory for WT history!\n");
       exit(EXIT_FAILURE);
     }
-    // Copy the symbol from the old word to the new word
-    memcpy(word->syms, w->syms, w->len);
-    // Append the symbol to the end of the new word
-    word->syms[w->len] = sym;
-    // Set the new words length to the old words length +1
-    word->len = w->len + 1;
-    return word;
-  } else {
-    // Else condition when there is no previous word and just created
-    // a length of 1 word symbol
-    Word *word = word_create(&sym, 1);
-    return word;
   }
+
+  // The new word starts at the end of the history, copy the symbols of the
+  // old word from earlier in the history and append the symbol after them
+  word->off = wt->hist_len;
+  word->len = w->len + 1;
+  memcpy(wt->hist + word->off, wt->hist + w->off, w->len);
+  wt->hist[word->off + w->len] = sym;
+  wt->hist_len += word->len;
+  return word;
 }
 
 //
-// Destructor for a Word.
+// Returns a pointer to the symbols of a Word in the history of a WordTable.
+// The pointer is only valid until the next Word is appended.
 //
-// w:       Word to free memory for.
-// returns: Void.
+// wt:      WordTable the Word belongs to.
+// w:       Word to get the symbols of.
+// returns: Pointer to the first symbol of the Word.
 //
-void word_delete(Word *w) {
-  free(w->syms);
-  free(w);
-  return;
+uint8_t *word_syms(WordTable *wt, Word *w) {
+  return wt->hist + w->off;
 }
 
 //
-// Creates a new WordTable, which is an array of Words.
-// A WordTable has a pre-defined size of MAX_CODE (UINT16_MAX - 1).
-// This is because codes are 16-bit integers.
+// Creates a new WordTable, which is an array of Words and their history.
+// A WordTable has a Word for every code of its width.
 // A WordTable is initialized with a single Word at index EMPTY_CODE.
 // This Word represents the empty word, a string of length of zero.
 //
+// width:   Number of bits of the largest code the WordTable holds.
 // returns: Initialized WordTable.
 //
-WordTable *wt_create(void) {
-  // Allowed memory for a word table with MAX_CODE elements
-  WordTable *wt = (WordTable *)calloc(MAX_CODE, sizeof(Word *));
+WordTable *wt_create(uint8_t width) {
+  WordTable *wt = (WordTable *)calloc(1, sizeof(WordTable));
   if (!wt) {
     printf("Error: Failed to allocate memory for WT!\n");
     exit(EXIT_FAILURE);
   }
 
-  // Allocated memory for the empty word
-  Word *word = (Word *)calloc(1, sizeof(Word));
-  if (!word) {
-    printf("Error: Failed to allocate memory for word struct!\n");
+  // Allowed memory for a word table with a Word for every code, the empty
+  // word at index 1/EMPTY_CODE has an offset and length of zero
+  wt->words = (Word *)calloc(CODE_MAX(width), sizeof(Word));
+  if (!wt->words) {
+    printf("Error: Failed to allocate memory for WT words!\n");
     exit(EXIT_FAILURE);
   }
 
-  word->syms = NULL;
-  word->len = 0;
-  // Set the index 1/EMPTY_CODE to the empty word
-  wt[EMPTY_CODE] = word;
+  // Allocate memory for the history the words refer to
+  wt->hist_cap = HISTORY;
+  wt->hist = (uint8_t *)malloc(wt->hist_cap);
+  if (!wt->hist) {
+    printf("Error: Failed to allocate memory for WT history!\n");
+    exit(EXIT_FAILURE);
+  }
   return wt;
 }
 
 //
 // Resets a WordTable to having just the empty Word.
+// The history is emptied but its memory is kept for reuse.
 //
 // wt:      WordTable to reset.
 // returns: Void.
 //
 void wt_reset(WordTable *wt) {
-  // Loop through all the element except for the empty word
-  // and deallowed all the word within the table
-  for (int i = 2; i < MAX_CODE; i++) {
-    // Check id the word exists
-    if (wt[i]) {
-      // Call the destructor to free the words memory
-      word_delete(wt[i]);
-    }
-  }
+  // Words past the empty word are overwritten before they are used again,
+  // so only the history needs to be emptied
+  wt->hist_len = 0;
   return;
 }
 
 //
-// Deletes an entire WordTable.
-// All Words in the WordTable must be deleted as well.
+// Rewinds a WordTable to the Words it had when its history had hist_len
+// symbols. Only Words appended since then are taken back out, so a Word
+// that was overwritten by a reset in between can't be rewound to.
+//
+// wt:       WordTable to rewind.
+// hist_len: Number of symbols the history had.
+// returns:  Void.
+//
+void wt_rewind(WordTable *wt, uint64_t hist_len) {
+  wt->hist_len = hist_len;
+  return;
+}
+
+//
+// Deletes an entire WordTable, including its history.
 //
 // wt:      WordTable to free memory for.
 // returns: Void.
 //
 void wt_delete(WordTable *wt) {
-  // Loop through all the words within the table
-  for (uint32_t i = 1; i < MAX_CODE; i++) {
-    // Check if the word exists
-    if (wt[i]) {
-      // Call destructor to free memory for word
-      word_delete(wt[i]);
-    }
-  }
+  free(wt->hist);
+  free(wt->words);
   free(wt);
   return;
 }
@@ -4,63 +4,82 @@
 #include "code.h"
 #include <inttypes.h>
 
+//
+// Initial number of bytes in the history of a WordTable.
+// The history doubles in size whenever a new Word doesn't fit.
+//
+#define HISTORY 65536
+
 //
 // Struct definition of a Word.
+// A Word doesn't own its symbols, it refers to where they were written in
+// the history of the WordTable it belongs to.
 //
-// syms:  A Word holds an array of symbols, stored as bytes in an array.
-// len:   Length of the array storing the symbols a Word represents.
+// off:   Offset of the first symbol of the Word in the history.
+// len:   Number of symbols the Word represents.
 //
 typedef struct Word {
-  uint8_t *syms;
+  uint64_t off;
   uint32_t len;
 } Word;
 
 //
-// Define an array of Words as a WordTable.
-//
-typedef Word *WordTable;
+// Struct definition of a WordTable.
+// Each decoded Word is written once into the history, which is exactly the
+// decoded output since the last reset. A new Word is then a single copy of
+// its prefix from the history followed by its last symbol.
+//
+// words:     Array of Words indexed by code, one for every code.
+// hist:      Buffer of every symbol decoded since the last reset.
+// hist_len:  Number of symbols in the history.
+// hist_cap:  Number of bytes allocated for the history.
+//
+typedef struct WordTable {
+  Word *words;
+  uint8_t *hist;
+  uint64_t hist_len;
+  uint64_t hist_cap;
+} WordTable;
 
 //
-// Constructor for a word.
-//
-// syms:    Array of symbols a Word represents.
-// len:     Length of the array of symbols.
-// returns: Pointer to a Word that has been allocated memory.
-//
-Word *word_create(uint8_t *syms, uint32_t len);
-
-//
-// Constructs a new Word from the specified Word appended with a symbol.
+// Constructs a new Word from the Word of the specified code appended with a
+// symbol and stores it at next_code in the WordTable.
 // The Word specified to append to may be empty.
 // If the above is the case, the new Word should contain only the symbol.
 //
-// w:       Word to append to.
-// sym:     Symbol to append.
-// returns: New Word which represents the result of appending.
+// wt:        WordTable that holds the Word to append to.
+// code:      Code of the Word to append to.
+// sym:       Symbol to append.
+// next_code: Code to store the new Word at.
+// returns:   New Word which represents the result of appending.
 //
-Word *word_append_sym(Word *w, uint8_t sym);
+Word *word_append_sym(WordTable *wt, uint32_t code, uint8_t sym,
+    uint32_t next_code);
 
 //
-// Destructor for a Word.
+// Returns a pointer to the symbols of a Word in the history of a WordTable.
+// The pointer is only valid until the next Word is appended.
 //
-// w:       Word to free memory for.
-// returns: Void.
+// wt:      WordTable the Word belongs to.
+// w:       Word to get the symbols of.
+// returns: Pointer to the first symbol of the Word.
 //
-void word_delete(Word *w);
+uint8_t *word_syms(WordTable *wt, Word *w);
 
 //
-// Creates a new WordTable, which is an array of Words.
-// A WordTable has a pre-defined size of MAX_CODE (UINT16_MAX - 1).
-// This is because codes are 16-bit integers.
+// Creates a new WordTable, which is an array of Words and their history.
+// A WordTable has a Word for every code of its width.
 // A WordTable is initialized with a single Word at index EMPTY_CODE.
 // This Word represents the empty word, a string of length of zero.
 //
+// width:   Number of bits of the largest code the WordTable holds.
 // returns: Initialized WordTable.
 //
-WordTable *wt_create(void);
+WordTable *wt_create(uint8_t width);
 
 //
 // Resets a WordTable to having just the empty Word.
+// The history is emptied but its memory is kept for reuse.
 //
 // wt:      WordTable to reset.
 // returns: Void.
@@ -68,8 +87,18 @@ WordTable *wt_create(void);
 void wt_reset(WordTable *wt);
 
 //
-// Deletes an entire WordTable.
-// All Words in the WordTable must be deleted as well.
+// Rewinds a WordTable to the Words it had when its history had hist_len
+// symbols. Only Words appended since then are taken back out, so a Word
+// that was overwritten by a reset in between can't be rewound to.
+//
+// wt:       WordTable to rewind.
+// hist_len: Number of symbols the history had.
+// returns:  Void.
+//
+void wt_rewind(WordTable *wt, uint64_t hist_len);
+
+//
+// Deletes an entire WordTable, including its history.
 //
 // wt:      WordTable to free memory for.
 // returns: Void.